@@ -0,0 +1,221 @@
+/**
+ * Event throughput and enqueue-to-handle latency, before and after the
+ * blocking, batch draining consumer.
+ *
+ * "before" replays the original queue_processing(): one 50 entry queue, a 1 s
+ * delay before each receive, one event per pass. "after" runs the real
+ * event_queue.c with a consumer that blocks in event_receive() and drains
+ * everything pending before it sleeps again.
+ *
+ * Usage: bench_event_queue [events] [seconds of the old loop, 0 to skip]
+*/
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "event_queue.h"
+#include "registry.h"
+
+#define OLD_QUEUE_LEN       50
+#define OLD_POLL_MS         1000
+#define OLD_RECEIVE_TICKS   100
+#define OLD_SEND_PERIOD_US  100000  // A report every 100 ms, as several probes and the app may produce
+
+#define PACED_PERIOD_US     200     // Spacing of the latency run, the consumer is idle between events
+
+typedef struct {
+    uint32_t *us;
+    uint32_t count;
+    uint32_t max;
+} latency_log_t;
+
+static device_desc_t *pump;
+static atomic_bool consumer_ready;
+static atomic_bool stop;
+static latency_log_t log_us;
+static atomic_uint handled;
+
+static uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static void sleep_us(uint32_t us)
+{
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void log_add(uint32_t us)
+{
+    if (log_us.count < log_us.max) {
+        log_us.us[log_us.count++] = us;
+    }
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void log_print(const char *name, double seconds)
+{
+    qsort(log_us.us, log_us.count, sizeof(uint32_t), compare_u32);
+    uint32_t n = log_us.count;
+    printf("%-22s %10.0f %10u %10u %10u %10u\n", name, atomic_load(&handled) / seconds, n,
+           n ? log_us.us[n / 2] : 0, n ? log_us.us[n * 99 / 100] : 0, n ? log_us.us[n - 1] : 0);
+    log_us.count = 0;
+    atomic_store(&handled, 0);
+}
+
+/******************************************************
+ * Before: 1 s polling loop on one queue
+******************************************************/
+
+static QueueHandle_t old_queue;
+
+static void *old_consumer(void *arg)
+{
+    event_packet_t event;
+
+    while (!atomic_load(&stop)) {
+        vTaskDelay(pdMS_TO_TICKS(OLD_POLL_MS));
+        if (xQueueReceive(old_queue, &event, OLD_RECEIVE_TICKS) == pdTRUE) {
+            log_add(now_us() - event.enqueued_us);
+            atomic_fetch_add(&handled, 1);
+        }
+    }
+    return NULL;
+}
+
+static void run_old_loop(uint32_t seconds)
+{
+    pthread_t consumer;
+    uint32_t sent = 0, lost = 0;
+
+    old_queue = xQueueCreate(OLD_QUEUE_LEN, sizeof(event_packet_t));
+    pthread_create(&consumer, NULL, old_consumer, NULL);
+
+    uint32_t start = now_us();
+    while (now_us() - start < seconds * 1000000u) {
+        event_packet_t event = {
+            .direction = ESP_TO_APP,
+            .device = registry_id(pump),
+            .payload = PAYLOAD_ON_OFF,
+            .enqueued_us = now_us(),
+        };
+        sent++;
+        lost += (xQueueSend(old_queue, &event, 0) != pdTRUE);
+        sleep_us(OLD_SEND_PERIOD_US);
+    }
+    double elapsed = (now_us() - start) / 1e6;
+    atomic_store(&stop, true);
+    pthread_join(consumer, NULL);
+    atomic_store(&stop, false);
+
+    log_print("before: 1 s poll", elapsed);
+    printf("  %u sent, %u refused by a full queue, %u still queued\n", sent, lost,
+           (unsigned)uxQueueMessagesWaiting(old_queue));
+    vQueueDelete(old_queue);
+}
+
+/******************************************************
+ * After: blocking, batch draining consumer
+******************************************************/
+
+static void *consumer(void *arg)
+{
+    event_queue_init();
+    atomic_store(&consumer_ready, true);
+
+    while (true) {
+        const event_packet_t *event = event_receive(pdMS_TO_TICKS(20));
+        if (!event) {
+            if (atomic_load(&stop)) {
+                break;
+            }
+            continue;
+        }
+        log_add(now_us() - event->enqueued_us);
+        atomic_fetch_add(&handled, 1);
+        event_release(event);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Post `count` pump commands, back to back or `period_us` apart.
+ * Commands use the blocking policy, so none is lost and every one is timed.
+*/
+static double run_producer(uint32_t count, uint32_t period_us)
+{
+    uint32_t start = now_us();
+
+    for (uint32_t i = 0; i < count; i++) {
+        event_packet_t command = {
+            .direction = APP_TO_ESP,
+            .device = registry_id(pump),
+            .payload = PAYLOAD_ON_OFF,
+            .data.on_off = i & 1,
+        };
+        while (!event_send(&command, PRODUCER_APP_PUMP)) {
+        }
+        if (period_us) {
+            sleep_us(period_us);
+        }
+    }
+    // Wait for the consumer to catch up before stopping the clock
+    while (atomic_load(&handled) < count) {
+        sleep_us(10);
+    }
+    return (now_us() - start) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t events = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+    uint32_t old_seconds = (argc > 2) ? strtoul(argv[2], NULL, 0) : 5;
+    pthread_t consumer_thread;
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    registry_init();
+    pump = registry_find(DEVICE_PUMP, 0);
+    log_us.max = events;
+    log_us.us = malloc(events * sizeof(uint32_t));
+    if (!log_us.us || events == 0) {
+        fprintf(stderr, "usage: %s [events > 0] [seconds]\n", argv[0]);
+        return 2;
+    }
+
+#ifdef CONFIG_EXAMPLE_EVENT_POOL
+    printf("Event lanes with a %d packet pool\n", EVENT_POOL_SIZE);
+#else
+    printf("Event lanes with packet copies\n");
+#endif
+    printf("%-22s %10s %10s %10s %10s %10s\n", "loop", "events/s", "events", "p50 us", "p99 us", "max us");
+
+    if (old_seconds) {
+        run_old_loop(old_seconds);
+    }
+
+    pthread_create(&consumer_thread, NULL, consumer, NULL);
+    while (!atomic_load(&consumer_ready)) {
+        sleep_us(100);
+    }
+
+    double elapsed = run_producer(events, 0);
+    log_print("after: saturated", elapsed);
+
+    uint32_t paced = events / 20 ? events / 20 : 1;
+    elapsed = run_producer(paced, PACED_PERIOD_US);
+    log_print("after: 1 per 200 us", elapsed);
+
+    atomic_store(&stop, true);
+    pthread_join(consumer_thread, NULL);
+    free(log_us.us);
+    return 0;
+}
@@ -0,0 +1,314 @@
+/**
+ * Simulated bed watered by the real node, run at accelerated time.
+ *
+ * A soil model dries the bed with a day/night cycle and the pump wets it. The
+ * probe sees the soil through a soak delay, its readings go through a noisy
+ * burst, sensor_filter.c and the sensor_cal.c table, then controller_update()
+ * as on the node. The node is brought up as app_main() does it and events are
+ * dispatched as its consumer does, through the real device.c and rainMaker.c.
+ * The cloud behind hal.h is a sink that counts what would have been sent.
+ *
+ * Usage: bench_garden_sim [days] [sample period s]
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <esp_log.h>
+
+#include "controller.h"
+#include "device.h"
+#include "event_queue.h"
+#include "rainMaker.h"
+#include "sensor_cal.h"
+#include "sensor_filter.h"
+#include "host_clock.h"
+#include "host_hal.h"
+#include "host_hardware.h"
+
+#define SIM_STEP_S          1
+#define SIM_BURST_SAMPLES   16
+#define SIM_NOISE_MV        25.0
+#define SIM_SPIKE_PERCENT   2       // Samples replaced by a full scale spike
+
+// Soil model, dryness in % as the probe reads it (higher is drier)
+#define SOIL_START          70.0
+#define SOIL_DRY_NIGHT_PH   1.0     // Drying per hour at night
+#define SOIL_DRY_NOON_PH    4.0     // Drying per hour at midday
+#define SOIL_WET_PER_S      0.5     // Wetting per second of pumping
+#define SOAK_TAU_S          45.0    // Lag between the soil and the probe
+
+// Low reservoir window on day two, the pump must stay off throughout
+#define LOW_WATER_FROM_S    (36 * 3600)
+#define LOW_WATER_TO_S      (40 * 3600)
+
+// MQTT down for a while on day two, readings go to the offline history meanwhile
+#define OFFLINE_FROM_S      (42 * 3600)
+#define OFFLINE_TO_S        (46 * 3600)
+
+typedef struct {
+    uint32_t events[DEVICE_TYPE_MAX];
+    uint32_t bytes;
+} sink_t;
+
+static double now_wall_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double gauss(void)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * @brief Take a noisy burst around the probe's true value and reduce it as the continuous ADC mode does.
+*/
+static float probe_read(const sensor_lut_t *lut, double dryness)
+{
+    uint16_t burst[SIM_BURST_SAMPLES];
+    // Inverse of sensor_cal_default, 0 % at 0 mV and 100 % at 3100 mV
+    double mv = dryness * 31.0;
+
+    for (int i = 0; i < SIM_BURST_SAMPLES; i++) {
+        double sample = mv + SIM_NOISE_MV * gauss();
+        if (rand() % 100 < SIM_SPIKE_PERCENT) {
+            sample = SENSOR_LUT_MAX_MV;
+        }
+        burst[i] = (uint16_t)(sample < 0 ? 0 : sample > SENSOR_LUT_MAX_MV ? SENSOR_LUT_MAX_MV : sample);
+    }
+    int filtered = sensor_filter_apply(SENSOR_FILTER_MEDIAN, burst, SIM_BURST_SAMPLES, 0);
+    return sensor_lut_lookup(lut, filtered) / 100.0f;
+}
+
+/**
+ * @brief Serve everything posted, as the node's event consumer does.
+*/
+static void consumer_drain(sink_t *sink)
+{
+    const event_packet_t *event;
+
+    while ((event = event_receive(0)) != NULL) {
+        device_desc_t *dev = registry_get(event->device);
+        if (dev) {
+            sink->events[dev->type]++;
+            sink->bytes += sizeof(*event);
+        }
+        if (event->direction == ESP_TO_APP) {
+            rainMaker_update(event);
+        } else {
+            hardware_update(event);
+            rainMaker_echo(event);
+        }
+        event_release(event);
+    }
+    rainMaker_flush();
+    controller_poll();
+}
+
+int main(int argc, char **argv)
+{
+    int days = (argc > 1) ? atoi(argv[1]) : 7;
+    int sample_s = (argc > 2) ? atoi(argv[2]) : REPORTING_PERIOD;
+    int failures = 0;
+
+    if (days < 2 || sample_s < 1) {
+        fprintf(stderr, "usage: %s [days >= 2] [sample period s]\n", argv[0]);
+        return 2;
+    }
+
+    srand(1);
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    host_clock_set_virtual(true);
+
+    // Bring-up as in app_main(), the other probes read 0 % and never decide
+    event_queue_init();
+    hardware_init(false, 0.0f);
+    device_desc_t *pump = registry_find(DEVICE_PUMP, 0);
+    device_desc_t *sensor = registry_find(DEVICE_SENSOR, 0);
+    wifi_init();
+    rainMaker_init();
+    rm_add_devices(DEVICE_LED);
+    rm_add_devices(DEVICE_PUMP);
+    rm_add_devices(DEVICE_SENSOR);
+    rainMaker_start();
+    wifi_start();
+    host_cloud_set_connected(true);
+
+    sensor_lut_t lut;
+    sensor_lut_build(&lut, &sensor_cal_default);
+
+    controller_config_t config;
+    controller_get_config(&config);
+    const int64_t max_run_s = pdTICKS_TO_MS(config.max_run) / 1000;
+
+    sink_t sink = { 0 };
+    double soil = SOIL_START;
+    double probe = SOIL_START;
+    TickType_t reported = 0;
+    bool reported_once = false;
+
+    // Control loop measurements
+    int64_t dry_since_s = -1;       // Soil past the dry threshold with the pump off
+    int64_t late_max_s = 0;
+    uint32_t late_starts = 0;
+    double start_soil_total = 0;
+    double start_soil_max = 0;
+    uint32_t starts = 0;
+    int64_t run_since_s = -1;
+    int64_t run_longest_s = 0;
+    int64_t pump_on_s = 0;
+    double probe_max = 0;
+    uint32_t samples = 0;
+    double update_wall_s = 0;
+    bool ran_while_low = false;
+    bool was_low = false;
+    bool was_offline = false;
+    bool was_on = false;
+    uint32_t pump_switches = 0;
+
+    const int64_t total_s = (int64_t)days * 86400;
+    double wall_start = now_wall_s();
+
+    for (int64_t t = 0; t < total_s; t += SIM_STEP_S) {
+        bool water_low = (t >= LOW_WATER_FROM_S && t < LOW_WATER_TO_S);
+        host_set_water_low(water_low);
+        if (water_low && !was_low) {
+            // The float switch cutoff, as input.c does on the falling edge
+            stop_pump(pump);
+        }
+        was_low = water_low;
+
+        bool offline = (t >= OFFLINE_FROM_S && t < OFFLINE_TO_S);
+        if (offline != was_offline) {
+            host_cloud_set_connected(!offline);
+        }
+        was_offline = offline;
+
+        // Soil dries fastest at midday and is wetted while the pump runs
+        double hour = fmod(t / 3600.0, 24.0);
+        double sun = fmax(0.0, sin((hour - 6.0) / 12.0 * M_PI));
+        soil += (SOIL_DRY_NIGHT_PH + (SOIL_DRY_NOON_PH - SOIL_DRY_NIGHT_PH) * sun) / 3600.0 * SIM_STEP_S;
+        if (pump->on_off) {
+            soil -= SOIL_WET_PER_S * SIM_STEP_S;
+            pump_on_s += SIM_STEP_S;
+        }
+        soil = fmin(100.0, fmax(0.0, soil));
+        probe += (soil - probe) * (SIM_STEP_S / SOAK_TAU_S);
+        probe_max = fmax(probe_max, probe);
+
+        pump_switches += (pump->on_off != was_on);
+        was_on = pump->on_off;
+        if (pump->on_off) {
+            ran_while_low |= water_low;
+            if (run_since_s < 0) {
+                run_since_s = t;
+            }
+            run_longest_s = (t - run_since_s > run_longest_s) ? t - run_since_s : run_longest_s;
+        } else {
+            run_since_s = -1;
+        }
+
+        if (t % sample_s == 0) {
+            sensor->reading = probe_read(&lut, probe);
+            samples++;
+
+            TickType_t now = xTaskGetTickCount();
+            if (!reported_once || now - reported >= pdMS_TO_TICKS(REPORTING_PERIOD * 1000)) {
+                event_packet_t sensor_data_to_app = {
+                    .direction = ESP_TO_APP,
+                    .device = registry_id(sensor),
+                    .payload = PAYLOAD_READING,
+                    .data.reading = sensor->reading,
+                };
+                event_send(&sensor_data_to_app, PRODUCER_SENSOR);
+                reported = now;
+                reported_once = true;
+            }
+
+            bool on_before = pump->on_off;
+            double start = now_wall_s();
+            controller_update(sensor);
+            update_wall_s += now_wall_s() - start;
+
+            // Noise may start the pump a little before the soil is past the threshold,
+            // the soak delay, sampling and min off time may start it after
+            if (!on_before && pump->on_off) {
+                starts++;
+                start_soil_total += soil;
+                start_soil_max = fmax(start_soil_max, soil);
+                if (dry_since_s >= 0) {
+                    late_starts++;
+                    late_max_s = (t - dry_since_s > late_max_s) ? t - dry_since_s : late_max_s;
+                }
+            }
+        }
+
+        // Time from the soil crossing the dry threshold until the pump starts, soak delay included
+        if (!pump->on_off && !water_low && soil >= config.dry) {
+            if (dry_since_s < 0) {
+                dry_since_s = t;
+            }
+        } else {
+            dry_since_s = -1;
+        }
+
+        consumer_drain(&sink);
+        host_clock_advance((int64_t)SIM_STEP_S * 1000000);
+    }
+
+    double wall_s = now_wall_s() - wall_start;
+    uint32_t total_events = sink.events[DEVICE_LED] + sink.events[DEVICE_PUMP] + sink.events[DEVICE_SENSOR];
+    host_cloud_stats_t cloud;
+    host_cloud_get_stats(&cloud);
+
+    printf("Simulated %d days, sample every %d s, %.2f s wall (%.0fx real time)\n",
+           days, sample_s, wall_s, total_s / wall_s);
+    printf("Event throughput: %u events, %.0f simulated steps/s\n",
+           total_events, total_s / SIM_STEP_S / wall_s);
+    printf("Control loop: controller_update() %.0f ns mean over %u samples\n",
+           update_wall_s / samples * 1e9, samples);
+    printf("Control loop: soil at pump start %.1f %% mean, %.1f %% worst over %u starts\n",
+           starts ? start_soil_total / starts : 0.0, start_soil_max, starts);
+    printf("Control loop: %u starts after the soil passed the dry threshold, up to %lld s late\n",
+           late_starts, (long long)late_max_s);
+    printf("Pump: %u switches, %.1f min/day running, longest run %lld s (max %lld s)\n",
+           pump_switches, pump_on_s / 60.0 / days, (long long)run_longest_s, (long long)max_run_s);
+    printf("Probe: driest reading %.1f %% (dry threshold %.0f %%)\n", probe_max, config.dry);
+    printf("Reporting volume per day: %.0f sensor, %.0f pump, %.0f led events, %.0f packet bytes\n",
+           (double)sink.events[DEVICE_SENSOR] / days, (double)sink.events[DEVICE_PUMP] / days,
+           (double)sink.events[DEVICE_LED] / days, (double)sink.bytes / days);
+    printf("Cloud: %u devices, %.0f params staged, %.0f reports per day, %u history publishes (%u bytes)\n",
+           cloud.devices, (double)cloud.staged / days, (double)cloud.reports / days,
+           cloud.publishes, cloud.publish_bytes);
+
+    for (int i = 0; i < PRODUCER_MAX; i++) {
+        event_producer_stats_t stats;
+        event_queue_get_stats(i, &stats);
+        if (stats.dropped || stats.pool_empty) {
+            printf("FAIL: producer %d dropped %u events\n", i, (unsigned)(stats.dropped + stats.pool_empty));
+            failures++;
+        }
+    }
+    if (starts == 0) {
+        printf("FAIL: the pump never started in %d days\n", days);
+        failures++;
+    }
+    if (run_longest_s > max_run_s + SIM_STEP_S) {
+        printf("FAIL: a run lasted %lld s, over the %lld s limit\n", (long long)run_longest_s, (long long)max_run_s);
+        failures++;
+    }
+    if (cloud.reports == 0 || cloud.publishes == 0) {
+        printf("FAIL: %u reports and %u history publishes reached the cloud\n", cloud.reports, cloud.publishes);
+        failures++;
+    }
+    if (ran_while_low) {
+        printf("FAIL: the pump ran while the water was low\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
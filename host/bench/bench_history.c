@@ -0,0 +1,120 @@
+/**
+ * Size and speed of the history codec in main/history.c.
+ *
+ * Usage: bench_history [samples per run]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "history.h"
+
+#define RUNS 20
+
+// Uncoded sample: 32 bit time, probe byte, 16 bit value
+#define RAW_SAMPLE_BYTES 7
+
+typedef struct {
+    const char *name;
+    uint8_t probes;
+    uint32_t period_s;
+    int drift;              // Largest step between two readings of a probe, 0.01 % units
+    int jump_percent;       // Readings replaced by a random jump
+} stream_desc_t;
+
+static const stream_desc_t streams[] = {
+    { "1 probe, 20 s, slow drift", 1, 20, 30, 0 },
+    { "4 probes, 20 s, slow drift", 4, 20, 30, 0 },
+    { "1 probe, 600 s, watering", 1, 600, 300, 10 },
+    { "16 probes, 5 s, noisy", 16, 5, 200, 5 },
+};
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_stream(const stream_desc_t *desc, history_sample_t *out, size_t count)
+{
+    uint16_t value[HISTORY_PROBES_MAX];
+    uint32_t time = 0;
+
+    for (uint8_t p = 0; p < desc->probes; p++) {
+        value[p] = 6000;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t probe = i % desc->probes;
+        if (probe == 0) {
+            time += desc->period_s;
+        }
+        int next = value[probe] + rand() % (2 * desc->drift + 1) - desc->drift;
+        if (rand() % 100 < desc->jump_percent) {
+            next = rand() % 10001;
+        }
+        value[probe] = (uint16_t)(next < 0 ? 0 : next > 10000 ? 10000 : next);
+        out[i] = (history_sample_t) { .time = time, .probe = probe, .centi_percent = value[probe] };
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+    history_sample_t *samples = malloc(count * sizeof(*samples));
+    history_sample_t *decoded = malloc(count * sizeof(*decoded));
+    // Large enough that nothing is dropped, the measured bytes are all the samples
+    size_t storage_size = (count * HISTORY_RECORD_MAX / HISTORY_BLOCK_SIZE + 2) * HISTORY_BLOCK_SIZE * 2;
+    uint8_t *storage = malloc(storage_size);
+    int failures = 0;
+
+    if (!samples || !decoded || !storage || count == 0) {
+        fprintf(stderr, "usage: %s [samples > 0]\n", argv[0]);
+        return 2;
+    }
+
+    printf("%-28s %8s %8s %8s %10s %10s\n", "stream", "B/sample", "vs raw", "blocks", "encode ns", "decode ns");
+    for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); s++) {
+        history_t history = { 0 };
+        double encode_s = 0, decode_s = 0;
+        size_t read = 0;
+
+        srand(14);
+        make_stream(&streams[s], samples, count);
+
+        for (int run = 0; run < RUNS; run++) {
+            history_resume(&history, storage, storage_size);
+            history_clear(&history);
+
+            double start = now_s();
+            for (size_t i = 0; i < count; i++) {
+                history_append(&history, &samples[i]);
+            }
+            encode_s += now_s() - start;
+
+            start = now_s();
+            read = 0;
+            for (size_t b = 0; b < history_blocks(&history); b++) {
+                read += history_read_block(&history, b, decoded + read, count - read);
+            }
+            decode_s += now_s() - start;
+        }
+
+        double bytes_per_sample = (double)history_bytes(&history) / count;
+        printf("%-28s %8.2f %7.0f%% %8zu %10.1f %10.1f\n", streams[s].name, bytes_per_sample,
+               100.0 * bytes_per_sample / RAW_SAMPLE_BYTES, history_blocks(&history),
+               encode_s / RUNS / count * 1e9, decode_s / RUNS / count * 1e9);
+
+        if (read != count || history.dropped) {
+            printf("FAIL: %s decoded %zu of %zu samples\n", streams[s].name, read, count);
+            failures++;
+        }
+    }
+    printf("Block size %d bytes, %d byte header, raw sample %d bytes\n",
+           HISTORY_BLOCK_SIZE, HISTORY_BLOCK_HEADER, RAW_SAMPLE_BYTES);
+
+    free(samples);
+    free(decoded);
+    free(storage);
+    return failures ? 1 : 0;
+}
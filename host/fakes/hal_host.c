@@ -0,0 +1,328 @@
+#include "host_hal.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define HOST_GPIO_MAX       64
+#define HOST_PWM_CHANNELS   8
+#define HOST_CLOUD_DEVICES  32
+
+typedef struct host_cloud_device host_cloud_device_t;
+
+typedef struct {
+    host_cloud_device_t *device;
+    uint8_t payload;
+    float value;
+} host_cloud_param_t;
+
+struct host_cloud_device {
+    hal_cloud_device_t desc;
+    host_cloud_param_t params[PAYLOAD_MAX];
+    uint32_t attributes;
+    bool added;
+};
+
+static bool gpio_level[HOST_GPIO_MAX];
+static uint16_t pwm_duty[HOST_PWM_CHANNELS];
+static uint8_t led_rgb[3];
+
+// Written by the event consumer and read by the test thread
+static pthread_mutex_t cloud_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_cloud_device_t cloud_devices[HOST_CLOUD_DEVICES];
+static uint32_t cloud_device_count;
+static host_cloud_stats_t cloud_stats;
+static bool cloud_failing;
+static hal_cloud_write_t cloud_write;
+static hal_cloud_connection_t cloud_connection;
+
+/******************************************************
+ * GPIO, pulse counter, PWM and LED
+******************************************************/
+
+esp_err_t hal_gpio_output(int gpio, bool pull_up)
+{
+    return (gpio >= 0 && gpio < HOST_GPIO_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void hal_gpio_write(int gpio, bool level)
+{
+    if (gpio >= 0 && gpio < HOST_GPIO_MAX) {
+        gpio_level[gpio] = level;
+    }
+}
+
+void hal_gpio_hold(int gpio, bool hold)
+{
+}
+
+void hal_gpio_hold_in_sleep(void)
+{
+}
+
+esp_err_t hal_gpio_input(int gpio, bool pull_up, hal_gpio_isr_t isr, void *arg)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    gpio_level[gpio] = pull_up;
+    return ESP_OK;
+}
+
+bool hal_gpio_read(int gpio)
+{
+    return (gpio >= 0 && gpio < HOST_GPIO_MAX) ? gpio_level[gpio] : false;
+}
+
+esp_err_t hal_counter_init(int gpio, hal_counter_t *counter)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+int32_t hal_counter_read(hal_counter_t counter)
+{
+    return 0;
+}
+
+esp_err_t hal_pwm_init(uint8_t channel, int gpio, uint32_t freq_hz, bool invert)
+{
+    if (channel >= HOST_PWM_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pwm_duty[channel] = 0;
+    return ESP_OK;
+}
+
+esp_err_t hal_pwm_fade(uint8_t channel, uint16_t permille, uint32_t ramp_ms)
+{
+    if (channel >= HOST_PWM_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // No ramp, the target is reached at once
+    pwm_duty[channel] = permille;
+    return ESP_OK;
+}
+
+void hal_pwm_stop(uint8_t channel)
+{
+    if (channel < HOST_PWM_CHANNELS) {
+        pwm_duty[channel] = 0;
+    }
+}
+
+esp_err_t hal_led_init(void)
+{
+    return ESP_OK;
+}
+
+void hal_led_write(uint8_t red, uint8_t green, uint8_t blue)
+{
+    led_rgb[0] = red;
+    led_rgb[1] = green;
+    led_rgb[2] = blue;
+}
+
+/******************************************************
+ * Storage and network, always up
+******************************************************/
+
+esp_err_t hal_storage_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t hal_wifi_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t hal_wifi_start(void)
+{
+    return ESP_OK;
+}
+
+/******************************************************
+ * Cloud node
+******************************************************/
+
+esp_err_t hal_cloud_init(const char *name, const char *type, hal_cloud_write_t write,
+                         hal_cloud_connection_t connection)
+{
+    cloud_write = write;
+    cloud_connection = connection;
+    return ESP_OK;
+}
+
+void *hal_cloud_device_create(const hal_cloud_device_t *desc, void *params[PAYLOAD_MAX])
+{
+    // Params each kind comes with, as on RainMaker
+    static const bool kind_params[][PAYLOAD_MAX] = {
+        [HAL_CLOUD_LIGHT] = { [PAYLOAD_ON_OFF] = true, [PAYLOAD_LEVEL] = true },
+        [HAL_CLOUD_FAN] = { [PAYLOAD_ON_OFF] = true, [PAYLOAD_LEVEL] = true },
+        [HAL_CLOUD_SENSOR] = { [PAYLOAD_READING] = true },
+        [HAL_CLOUD_PLAIN] = { false },
+    };
+    host_cloud_device_t *device = NULL;
+
+    pthread_mutex_lock(&cloud_lock);
+    if (cloud_device_count < HOST_CLOUD_DEVICES) {
+        device = &cloud_devices[cloud_device_count++];
+        *device = (host_cloud_device_t) { .desc = *desc };
+        device->params[PAYLOAD_ON_OFF].value = desc->on_off;
+        device->params[PAYLOAD_LEVEL].value = desc->level;
+        device->params[PAYLOAD_READING].value = desc->reading;
+        for (uint8_t payload = 0; payload < PAYLOAD_MAX; payload++) {
+            device->params[payload].device = device;
+            device->params[payload].payload = payload;
+            params[payload] = kind_params[desc->kind][payload] ? &device->params[payload] : NULL;
+        }
+    }
+    pthread_mutex_unlock(&cloud_lock);
+    return device;
+}
+
+esp_err_t hal_cloud_device_add_attribute(void *device, const char *name, const char *value)
+{
+    host_cloud_device_t *dev = device;
+
+    dev->attributes++;
+    return ESP_OK;
+}
+
+esp_err_t hal_cloud_node_add_device(void *device)
+{
+    host_cloud_device_t *dev = device;
+
+    pthread_mutex_lock(&cloud_lock);
+    if (!dev->added) {
+        dev->added = true;
+        cloud_stats.devices++;
+    }
+    pthread_mutex_unlock(&cloud_lock);
+    return ESP_OK;
+}
+
+esp_err_t hal_cloud_start(void)
+{
+    return ESP_OK;
+}
+
+const char *hal_cloud_node_id(void)
+{
+    return "host";
+}
+
+/******************************************************
+ * Cloud sink
+******************************************************/
+
+esp_err_t hal_cloud_stage(void *param, const event_packet_t *event)
+{
+    host_cloud_param_t *p = param;
+
+    pthread_mutex_lock(&cloud_lock);
+    switch (event->payload) {
+        case PAYLOAD_ON_OFF:
+            p->value = event->data.on_off;
+            break;
+        case PAYLOAD_LEVEL:
+            p->value = event->data.level;
+            break;
+        default:
+            p->value = event->data.reading;
+            break;
+    }
+    cloud_stats.staged++;
+    pthread_mutex_unlock(&cloud_lock);
+    return ESP_OK;
+}
+
+esp_err_t hal_cloud_report(void)
+{
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&cloud_lock);
+    if (cloud_failing) {
+        err = ESP_FAIL;
+    } else {
+        cloud_stats.reports++;
+    }
+    pthread_mutex_unlock(&cloud_lock);
+    return err;
+}
+
+esp_err_t hal_cloud_publish(const char *topic, const char *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&cloud_lock);
+    if (cloud_failing) {
+        err = ESP_FAIL;
+    } else {
+        cloud_stats.publishes++;
+        cloud_stats.publish_bytes += len;
+    }
+    pthread_mutex_unlock(&cloud_lock);
+    return err;
+}
+
+esp_err_t hal_cloud_reset(bool factory)
+{
+    return ESP_OK;
+}
+
+/******************************************************
+ * host_hal.h
+******************************************************/
+
+bool host_gpio_level(int gpio)
+{
+    return hal_gpio_read(gpio);
+}
+
+uint16_t host_pwm_duty(uint8_t channel)
+{
+    return (channel < HOST_PWM_CHANNELS) ? pwm_duty[channel] : 0;
+}
+
+void host_led_rgb(uint8_t *red, uint8_t *green, uint8_t *blue)
+{
+    *red = led_rgb[0];
+    *green = led_rgb[1];
+    *blue = led_rgb[2];
+}
+
+void host_cloud_get_stats(host_cloud_stats_t *stats)
+{
+    pthread_mutex_lock(&cloud_lock);
+    *stats = cloud_stats;
+    pthread_mutex_unlock(&cloud_lock);
+}
+
+float host_cloud_param_value(const void *param)
+{
+    const host_cloud_param_t *p = param;
+
+    pthread_mutex_lock(&cloud_lock);
+    float value = p->value;
+    pthread_mutex_unlock(&cloud_lock);
+    return value;
+}
+
+esp_err_t host_cloud_write(void *param, int32_t value)
+{
+    host_cloud_param_t *p = param;
+
+    return cloud_write(p->device->desc.priv, param, value, "host");
+}
+
+void host_cloud_set_connected(bool connected)
+{
+    cloud_connection(connected);
+}
+
+void host_cloud_set_failing(bool failing)
+{
+    pthread_mutex_lock(&cloud_lock);
+    cloud_failing = failing;
+    pthread_mutex_unlock(&cloud_lock);
+}
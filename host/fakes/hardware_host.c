@@ -0,0 +1,131 @@
+#include "input.h"
+#include "persist.h"
+#include "power.h"
+#include "sensor.h"
+#include "cpu_load.h"
+#include "mem_report.h"
+#include "host_hardware.h"
+
+#include <stdatomic.h>
+
+// The subsystems that stay on the chip: buttons and float switches, NVS, sleep and the ADC.
+// device.c, status_led.c and rainMaker.c around them are the real ones
+
+static atomic_bool water_low;
+
+void host_set_water_low(bool low)
+{
+    atomic_store(&water_low, low);
+}
+
+/******************************************************
+ * input.h, the float switch is set by the test
+******************************************************/
+
+void input_init(void)
+{
+}
+
+bool input_water_low(void)
+{
+    return atomic_load(&water_low);
+}
+
+void input_log(void)
+{
+}
+
+void input_register_console(void)
+{
+}
+
+/******************************************************
+ * persist.h, nothing is saved on the host
+******************************************************/
+
+void persist_init(void)
+{
+}
+
+void persist_restore(device_desc_t *dev)
+{
+}
+
+void persist_start(void)
+{
+}
+
+void persist_mark_dirty(persist_kind_t kind)
+{
+}
+
+TickType_t persist_poll(void)
+{
+    return portMAX_DELAY;
+}
+
+/******************************************************
+ * power.h, always a cold boot that stays awake
+******************************************************/
+
+void power_init(void)
+{
+}
+
+bool power_resumed(void)
+{
+    return false;
+}
+
+void power_restore(device_desc_t *dev)
+{
+}
+
+uint32_t power_sample_period_ms(uint32_t fallback)
+{
+    return fallback;
+}
+
+bool power_network_due(void)
+{
+    return true;
+}
+
+void power_scan_done(uint32_t period_ms)
+{
+}
+
+TickType_t power_poll(bool idle)
+{
+    return portMAX_DELAY;
+}
+
+/******************************************************
+ * sensor.h, readings are posted by the test
+******************************************************/
+
+static esp_err_t sensor_init(device_desc_t *dev)
+{
+    return ESP_OK;
+}
+
+const device_hw_ops_t sensor_hw_ops = {
+    .init = sensor_init,
+    .apply = NULL,
+};
+
+void sensor_request_sample(void)
+{
+}
+
+/******************************************************
+ * cpu_load.h and mem_report.h, no console on the host
+******************************************************/
+
+void cpu_load_register_console(void)
+{
+}
+
+void mem_report_register_console(void)
+{
+}
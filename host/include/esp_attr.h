@@ -0,0 +1,6 @@
+#pragma once
+
+// No RTC memory or IRAM on the host, placement attributes are dropped
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Microseconds on the host clock, see host_clock.h.
+*/
+int64_t esp_timer_get_time(void);
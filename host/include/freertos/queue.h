@@ -0,0 +1,25 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+
+#define xQueueCreateStatic(length, item_size, storage, buffer) xQueueCreate(length, item_size)
+
+/**
+ * @brief Copy an item to the back of the queue, waiting up to `wait` ticks for room.
+*/
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+
+/**
+ * @brief Copy the front item without taking it off the queue.
+*/
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait);
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+void vQueueDelete(QueueHandle_t queue);
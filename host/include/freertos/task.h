@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+
+/**
+ * @brief Handle of the calling thread, created on first use so any pthread can be a task.
+*/
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait);
+
+/**
+ * @brief Ticks on the host clock, see host_clock.h.
+*/
+TickType_t xTaskGetTickCount(void);
+
+void vTaskDelay(TickType_t ticks);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Clock behind esp_timer_get_time() and xTaskGetTickCount() on the host.
+// Real time by default, a simulation switches to virtual time and advances
+// it itself to run days in seconds. Blocking waits always use real time
+
+void host_clock_set_virtual(bool virtual_time);
+
+/**
+ * @brief Move virtual time forward, ignored while on real time.
+*/
+void host_clock_advance(int64_t us);
+
+int64_t host_clock_us(void);
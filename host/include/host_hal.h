@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+// Fake board and cloud under device.c, status_led.c and rainMaker.c, see fakes/hal_host.c.
+// Outputs only record what was last written, the cloud counts what would have gone out
+
+typedef struct {
+    uint32_t devices;       // Devices added to the node
+    uint32_t staged;        // hal_cloud_stage() calls
+    uint32_t reports;       // hal_cloud_report() calls
+    uint32_t publishes;     // hal_cloud_publish() calls
+    uint32_t publish_bytes;
+} host_cloud_stats_t;
+
+/**
+ * @brief Last level written to an output pad.
+*/
+bool host_gpio_level(int gpio);
+
+/**
+ * @brief Duty a PWM channel was last faded to, in permille.
+*/
+uint16_t host_pwm_duty(uint8_t channel);
+
+/**
+ * @brief Colour last shown on the status LED.
+*/
+void host_led_rgb(uint8_t *red, uint8_t *green, uint8_t *blue);
+
+void host_cloud_get_stats(host_cloud_stats_t *stats);
+
+/**
+ * @brief Last value staged for a param, the handle as hal_cloud_device_create() gave it out.
+*/
+float host_cloud_param_value(const void *param);
+
+/**
+ * @brief Write a param as the app would, through the callback given to hal_cloud_init().
+ * Booleans are written as 0 or 1.
+*/
+esp_err_t host_cloud_write(void *param, int32_t value);
+
+/**
+ * @brief Bring the MQTT connection up or down, through the callback given to hal_cloud_init().
+*/
+void host_cloud_set_connected(bool connected);
+
+/**
+ * @brief Make the next reports and publishes fail, as with the connection down.
+*/
+void host_cloud_set_failing(bool failing);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Fakes for the subsystems that stay on the chip, see fakes/hardware_host.c.
+// Inputs, NVS, sleep and the ADC do nothing unless set from here
+
+/**
+ * @brief What input_water_low() reports, standing in for the float switches.
+*/
+void host_set_water_low(bool low);
@@ -0,0 +1,30 @@
+#pragma once
+
+// Kconfig defaults with the sensor and pump enabled, for the parts of main/ built on the host.
+// Four probes share one power pin so the lanes see several sensors.
+// CONFIG_EXAMPLE_EVENT_POOL is left to the build so both queue item modes can be tested
+#define CONFIG_FREERTOS_HZ 1000
+
+#define CONFIG_EXAMPLE_ENABLE_PUMP 1
+#define CONFIG_EXAMPLE_ENABLE_SENSOR 1
+#define CONFIG_EXAMPLE_SENSOR_ADC_CHANNELS "0,1,2,3"
+#define CONFIG_EXAMPLE_SENSOR_POWER_GPIOS "40"
+#define CONFIG_EXAMPLE_SAMPLE_PERIOD_MIN_S 5
+#define CONFIG_EXAMPLE_SAMPLE_PERIOD_MAX_S 600
+#define CONFIG_EXAMPLE_REPORT_PERIOD_S 20
+#define CONFIG_EXAMPLE_CONTROLLER 1
+#define CONFIG_EXAMPLE_CONTROL_MIN_ON_S 10
+#define CONFIG_EXAMPLE_CONTROL_MIN_OFF_S 60
+#define CONFIG_EXAMPLE_CONTROL_MAX_RUN_S 120
+#define CONFIG_EXAMPLE_REPORT_DEADBAND 5
+#define CONFIG_EXAMPLE_REPORT_BATCH_MS 200
+#define CONFIG_EXAMPLE_REPORT_MIN_INTERVAL_MS 1000
+#define CONFIG_EXAMPLE_HISTORY 1
+#define CONFIG_EXAMPLE_HISTORY_SIZE 2048
+#define CONFIG_EXAMPLE_HISTORY_FLUSH_BLOCKS 4
+#define CONFIG_EXAMPLE_PERSIST_WRITES_PER_HOUR 12
+#define CONFIG_EXAMPLE_PUMP_RELAY 1
+#define CONFIG_EXAMPLE_INPUT_DEBOUNCE_MS 30
+#define CONFIG_EXAMPLE_FLOAT_SWITCH_LOW_LEVEL 0
+#define CONFIG_EXAMPLE_BOARD_BUTTON_GPIO 0
+#define CONFIG_EXAMPLE_RELAY_GPIO 10
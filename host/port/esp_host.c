@@ -0,0 +1,84 @@
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+
+#include <stdatomic.h>
+#include <time.h>
+
+#include "host_clock.h"
+
+static atomic_int log_level = ESP_LOG_INFO;
+static atomic_bool clock_virtual;
+static atomic_llong clock_virtual_us;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:
+            return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        default:
+            return "UNKNOWN ERROR";
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    atomic_store(&log_level, level);
+}
+
+esp_log_level_t esp_log_level_get(void)
+{
+    return atomic_load(&log_level);
+}
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+    return ESP_OK;
+}
+
+void host_clock_set_virtual(bool virtual_time)
+{
+    if (virtual_time) {
+        // Carry on from the real clock so ticks never run backwards
+        atomic_store(&clock_virtual_us, host_clock_us());
+    }
+    atomic_store(&clock_virtual, virtual_time);
+}
+
+void host_clock_advance(int64_t us)
+{
+    if (atomic_load(&clock_virtual)) {
+        atomic_fetch_add(&clock_virtual_us, us);
+    }
+}
+
+int64_t host_clock_us(void)
+{
+    if (atomic_load(&clock_virtual)) {
+        return atomic_load(&clock_virtual_us);
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_clock_us();
+}
@@ -0,0 +1,271 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_clock.h"
+
+struct host_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;     // Signalled on every send and receive
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct host_task {
+    pthread_mutex_t mutex;
+    pthread_cond_t notified;
+    uint32_t notify_count;
+};
+
+static _Thread_local struct host_task *current_task;
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec deadline(TickType_t wait)
+{
+    struct timespec ts;
+    uint64_t ms = pdTICKS_TO_MS(wait);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/**
+ * @brief Wait on `cond` until `ready` holds or `wait` ticks pass, `mutex` held throughout.
+*/
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t wait,
+                       bool (*ready)(const void *), const void *arg)
+{
+    struct timespec until = deadline(wait);
+
+    while (!ready(arg)) {
+        if (wait == 0) {
+            return false;
+        }
+        if (wait == portMAX_DELAY) {
+            pthread_cond_wait(cond, mutex);
+        } else if (pthread_cond_timedwait(cond, mutex, &until) == ETIMEDOUT) {
+            return ready(arg);
+        }
+    }
+    return true;
+}
+
+/******************************************************
+ * Queues
+******************************************************/
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+
+    if (!queue) {
+        return NULL;
+    }
+    queue->storage = calloc(length, item_size);
+    if (!queue->storage) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->mutex, NULL);
+    cond_init(&queue->changed);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->storage);
+    free(queue);
+}
+
+static bool queue_has_room(const void *arg)
+{
+    const struct host_queue *queue = arg;
+    return queue->count < queue->length;
+}
+
+static bool queue_has_item(const void *arg)
+{
+    const struct host_queue *queue = arg;
+    return queue->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!wait_until(&queue->changed, &queue->mutex, wait, queue_has_room, queue)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!wait_until(&queue->changed, &queue->mutex, wait, queue_has_item, queue)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->mutex);
+    if (!wait_until(&queue->changed, &queue->mutex, wait, queue_has_item, queue)) {
+        pthread_mutex_unlock(&queue->mutex);
+        return pdFALSE;
+    }
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+/******************************************************
+ * Mutexes
+******************************************************/
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    pthread_mutex_init(&buffer->mutex, NULL);
+    return buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    StaticSemaphore_t *semaphore = malloc(sizeof(*semaphore));
+
+    return semaphore ? xSemaphoreCreateMutexStatic(semaphore) : NULL;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    if (wait == portMAX_DELAY) {
+        return pthread_mutex_lock(&semaphore->mutex) == 0;
+    }
+    if (wait == 0) {
+        return pthread_mutex_trylock(&semaphore->mutex) == 0;
+    }
+    // pthread_mutex_timedlock() runs on CLOCK_REALTIME
+    struct timespec until;
+    uint64_t ms = pdTICKS_TO_MS(wait);
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    return pthread_mutex_timedlock(&semaphore->mutex, &until) == 0;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return pthread_mutex_unlock(&semaphore->mutex) == 0;
+}
+
+/******************************************************
+ * Task notifications and time
+******************************************************/
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!current_task) {
+        // Lives as long as the process, handles may be used after their thread exits
+        current_task = calloc(1, sizeof(*current_task));
+        pthread_mutex_init(&current_task->mutex, NULL);
+        cond_init(&current_task->notified);
+    }
+    return current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->mutex);
+    task->notify_count++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->mutex);
+    return pdPASS;
+}
+
+static bool task_notified(const void *arg)
+{
+    const struct host_task *task = arg;
+    return task->notify_count > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    uint32_t count = 0;
+
+    pthread_mutex_lock(&task->mutex);
+    if (wait_until(&task->notified, &task->mutex, wait, task_notified, task)) {
+        count = task->notify_count;
+        task->notify_count = clear_on_exit ? 0 : count - 1;
+    }
+    pthread_mutex_unlock(&task->mutex);
+    return count;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_clock_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    uint64_t us = (uint64_t)pdTICKS_TO_MS(ticks) * 1000;
+    struct timespec ts = {
+        .tv_sec = us / 1000000,
+        .tv_nsec = (long)(us % 1000000) * 1000,
+    };
+
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdio.h>
+
+// Minimal assertions for the host tests, a failed check is reported and the test carries on
+static int check_failures;
+
+#define CHECK(cond, fmt, ...) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
+            check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_DONE() (printf("%s\n", check_failures ? "FAILED" : "OK"), check_failures ? 1 : 0)
@@ -0,0 +1,93 @@
+/**
+ * App writes through the real rainMaker.c and device.c: a param write becomes a
+ * command, the command drives the relay, and the applied state is echoed back
+ * with the next batched report.
+*/
+#include <esp_log.h>
+
+#include "device.h"
+#include "event_queue.h"
+#include "rainMaker.h"
+#include "host_clock.h"
+#include "host_hal.h"
+#include "host_hardware.h"
+#include "check.h"
+
+/**
+ * @brief Serve every pending command as the node's consumer does, then let the batch window pass.
+ *
+ * @return commands served
+*/
+static int serve(void)
+{
+    const event_packet_t *event;
+    int served = 0;
+
+    while ((event = event_receive(0)) != NULL) {
+        if (event->direction == APP_TO_ESP) {
+            hardware_update(event);
+            rainMaker_echo(event);
+            served++;
+        } else {
+            rainMaker_update(event);
+        }
+        event_release(event);
+    }
+    host_clock_advance(REPORT_MIN_INTERVAL_MS * 1000LL);
+    rainMaker_flush();
+    return served;
+}
+
+int main(void)
+{
+    host_cloud_stats_t before, after;
+
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    host_clock_set_virtual(true);
+    event_queue_init();
+    hardware_init(false, 0.0f);
+    rainMaker_init();
+    rm_add_devices(DEVICE_LED);
+    rm_add_devices(DEVICE_PUMP);
+    rm_add_devices(DEVICE_SENSOR);
+    rainMaker_start();
+    host_cloud_set_connected(true);
+    serve();
+
+    device_desc_t *pump = registry_find(DEVICE_PUMP, 0);
+    device_desc_t *sensor = registry_find(DEVICE_SENSOR, 0);
+    void *power = pump->rm_params[PAYLOAD_ON_OFF];
+    void *speed = pump->rm_params[PAYLOAD_LEVEL];
+    CHECK(power && speed && !pump->rm_params[PAYLOAD_READING], "pump params not created as a fan");
+
+    // Switch on from the app
+    host_cloud_get_stats(&before);
+    host_cloud_write(power, 1);
+    CHECK(serve() == 1, "power write did not become one command");
+    host_cloud_get_stats(&after);
+    CHECK(pump->on_off && host_gpio_level(pump->gpio) == RELAY_ACTIVE_LEVEL, "relay not switched on");
+    CHECK(host_cloud_param_value(power) == 1.0f, "applied state not echoed");
+    CHECK(after.reports == before.reports + 1, "%u reports for one write", after.reports - before.reports);
+
+    // Speeds past the range are clamped and echoed as applied
+    host_cloud_write(speed, 9);
+    serve();
+    CHECK(pump->level == PUMP_SPEED_MAX, "speed %d, expected %d", pump->level, PUMP_SPEED_MAX);
+    CHECK(host_cloud_param_value(speed) == PUMP_SPEED_MAX, "clamped speed not echoed");
+
+    // A low reservoir refuses the start and the app's switch is put back
+    host_cloud_write(power, 0);
+    serve();
+    host_set_water_low(true);
+    host_cloud_write(power, 1);
+    serve();
+    CHECK(!pump->on_off && host_gpio_level(pump->gpio) != RELAY_ACTIVE_LEVEL, "pump started on low water");
+    CHECK(host_cloud_param_value(power) == 0.0f, "refused start not echoed as off");
+    host_set_water_low(false);
+
+    // Readings are reported, never written
+    host_cloud_write(sensor->rm_params[PAYLOAD_READING], 50);
+    CHECK(serve() == 0, "a sensor reading was accepted as a command");
+
+    return CHECK_DONE();
+}
@@ -0,0 +1,249 @@
+/**
+ * Flood the telemetry lane of main/event_queue.c and check that app commands
+ * still reach the consumer within a fixed bound.
+ *
+ * Sensor telemetry is posted flat out while the consumer spends TELEMETRY_SERVICE_US
+ * on each telemetry event, as a cloud publish would, so the telemetry lane stays
+ * full. Pump commands arrive every COMMAND_PERIOD_US meanwhile. With strict
+ * priority a command waits for at most the event being served when it arrives.
+*/
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "event_queue.h"
+#include "registry.h"
+#include "check.h"
+
+#define SENSORS                 4
+#define COMMANDS                400
+#define COMMAND_PERIOD_US       2000
+#define TELEMETRY_SERVICE_US    1000
+#define COMMAND_SERVICE_US      50
+
+// One telemetry service plus scheduling slack on a loaded host
+#define COMMAND_LATENCY_BOUND_US 10000
+
+static atomic_bool consumer_ready;
+static atomic_bool producers_done;
+
+static device_desc_t *pump;
+static device_desc_t *sensors[SENSORS];
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+} lane_latency_t;
+
+static lane_latency_t command_latency;
+static lane_latency_t telemetry_latency;
+
+static uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static void busy_wait_us(uint32_t us)
+{
+    uint32_t start = now_us();
+    while (now_us() - start < us) {
+    }
+}
+
+static void sleep_us(uint32_t us)
+{
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = (long)us * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void latency_add(lane_latency_t *latency, uint32_t us)
+{
+    latency->count++;
+    latency->total_us += us;
+    if (us > latency->max_us) {
+        latency->max_us = us;
+    }
+}
+
+static void *consumer(void *arg)
+{
+    event_queue_init();
+    atomic_store(&consumer_ready, true);
+
+    while (true) {
+        const event_packet_t *event = event_receive(pdMS_TO_TICKS(10));
+        if (!event) {
+            if (atomic_load(&producers_done)) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t waited = now_us() - event->enqueued_us;
+        if (event->direction == APP_TO_ESP) {
+            latency_add(&command_latency, waited);
+            busy_wait_us(COMMAND_SERVICE_US);
+        } else {
+            latency_add(&telemetry_latency, waited);
+            busy_wait_us(TELEMETRY_SERVICE_US);
+        }
+        event_release(event);
+    }
+    return NULL;
+}
+
+static void *telemetry_flood(void *arg)
+{
+    uint32_t n = 0;
+
+    while (!atomic_load(&producers_done)) {
+        event_packet_t reading = {
+            .direction = ESP_TO_APP,
+            .device = registry_id(sensors[n % SENSORS]),
+            .payload = PAYLOAD_READING,
+            .data.reading = (float)(n % 100),
+        };
+        event_send(&reading, PRODUCER_SENSOR);
+
+        // Controller state changes share the lane through the latest-value slots
+        if (n % 16 == 0) {
+            event_packet_t state = {
+                .direction = ESP_TO_APP,
+                .device = registry_id(pump),
+                .payload = PAYLOAD_ON_OFF,
+                .data.on_off = n & 32,
+            };
+            event_send(&state, PRODUCER_CONTROLLER);
+        }
+        n++;
+        if (n % 64 == 0) {
+            sleep_us(10);
+        }
+    }
+    return NULL;
+}
+
+static void *commands(void *arg)
+{
+    uint32_t *rejected = arg;
+
+    for (int i = 0; i < COMMANDS; i++) {
+        event_packet_t command = {
+            .direction = APP_TO_ESP,
+            .device = registry_id(pump),
+            .payload = PAYLOAD_ON_OFF,
+            .data.on_off = i & 1,
+        };
+        if (!event_send(&command, PRODUCER_APP_PUMP)) {
+            (*rejected)++;
+        }
+        sleep_us(COMMAND_PERIOD_US);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Queued and coalesced events on one lane come out in the order they were sent.
+ * Runs once the consumer has stopped, the lane is drained from here.
+*/
+static void test_send_order(void)
+{
+    const struct {
+        event_producer_t producer;
+        device_desc_t *dev;
+        uint8_t payload;
+    } sent[] = {
+        { PRODUCER_BUTTON, pump, PAYLOAD_ON_OFF },              // Coalesced
+        { PRODUCER_SENSOR, sensors[0], PAYLOAD_READING },       // Queued
+        { PRODUCER_CONTROLLER, sensors[1], PAYLOAD_ON_OFF },    // Coalesced
+    };
+    const int count = sizeof(sent) / sizeof(sent[0]);
+
+    for (int i = 0; i < count; i++) {
+        event_packet_t event = {
+            .direction = ESP_TO_APP,
+            .device = registry_id(sent[i].dev),
+            .payload = sent[i].payload,
+        };
+        event_send(&event, sent[i].producer);
+        // Distinct send times
+        sleep_us(200);
+    }
+
+    for (int i = 0; i < count; i++) {
+        const event_packet_t *event = event_receive(0);
+        if (!event) {
+            CHECK(false, "event %d of %d missing", i, count);
+            return;
+        }
+        CHECK(event->device == registry_id(sent[i].dev) && event->payload == sent[i].payload,
+              "event %d came out of send order", i);
+        event_release(event);
+    }
+    CHECK(event_receive(0) == NULL, "lane not empty after the order test");
+}
+
+int main(void)
+{
+    pthread_t consumer_thread, flood_thread, command_thread;
+    uint32_t rejected = 0;
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    // The node's own devices, host/include/sdkconfig.h lists SENSORS probes
+    registry_init();
+    pump = registry_find(DEVICE_PUMP, 0);
+    for (int i = 0; i < SENSORS; i++) {
+        sensors[i] = registry_find(DEVICE_SENSOR, i);
+        if (!sensors[i]) {
+            CHECK(false, "probe %d missing from the registry", i);
+            return CHECK_DONE();
+        }
+    }
+
+    pthread_create(&consumer_thread, NULL, consumer, NULL);
+    while (!atomic_load(&consumer_ready)) {
+        sleep_us(100);
+    }
+    pthread_create(&flood_thread, NULL, telemetry_flood, NULL);
+    // Let the telemetry lane fill before the first command
+    sleep_us(100 * 1000);
+    pthread_create(&command_thread, NULL, commands, &rejected);
+
+    pthread_join(command_thread, NULL);
+    atomic_store(&producers_done, true);
+    pthread_join(flood_thread, NULL);
+    pthread_join(consumer_thread, NULL);
+
+    event_producer_stats_t sensor_stats, command_stats;
+    event_queue_get_stats(PRODUCER_SENSOR, &sensor_stats);
+    event_queue_get_stats(PRODUCER_APP_PUMP, &command_stats);
+
+    printf("commands:  %u served, mean %llu us, max %u us (bound %u us)\n", command_latency.count,
+           (unsigned long long)(command_latency.count ? command_latency.total_us / command_latency.count : 0),
+           command_latency.max_us, COMMAND_LATENCY_BOUND_US);
+    printf("telemetry: %u served, mean %llu us, max %u us, %u overwritten\n", telemetry_latency.count,
+           (unsigned long long)(telemetry_latency.count ? telemetry_latency.total_us / telemetry_latency.count : 0),
+           telemetry_latency.max_us, (unsigned)sensor_stats.overwritten);
+    esp_log_level_set("*", ESP_LOG_INFO);
+    event_queue_log_stats();
+
+    CHECK(sensor_stats.overwritten > 0, "telemetry lane never overflowed, the flood did not happen");
+    CHECK(rejected == 0 && command_stats.dropped == 0, "%u commands rejected", rejected);
+    CHECK(command_latency.count == COMMANDS, "%u of %d commands served", command_latency.count, COMMANDS);
+    CHECK(command_latency.max_us <= COMMAND_LATENCY_BOUND_US, "command waited %u us, bound is %u us",
+          command_latency.max_us, COMMAND_LATENCY_BOUND_US);
+
+    test_send_order();
+
+    for (int i = 0; i < PRODUCER_MAX; i++) {
+        event_producer_stats_t stats;
+        event_queue_get_stats(i, &stats);
+        CHECK(stats.pool_empty == 0, "producer %d found the packet pool empty %u times", i,
+              (unsigned)stats.pool_empty);
+    }
+    return CHECK_DONE();
+}
@@ -0,0 +1,183 @@
+/**
+ * Round trip of the delta/varint history codec in main/history.c.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "history.h"
+#include "check.h"
+
+#define STREAM_MAX 4096
+
+static history_sample_t stream[STREAM_MAX];
+
+/**
+ * @brief Readings of `probes` probes sampled in turn, a slow random walk with the odd jump.
+*/
+static size_t make_stream(size_t count, uint8_t probes, uint32_t period_s)
+{
+    uint16_t value[HISTORY_PROBES_MAX];
+    uint32_t time = 1000;
+
+    for (uint8_t p = 0; p < probes; p++) {
+        value[p] = 5000 + p * 500;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t probe = i % probes;
+        if (probe == 0) {
+            time += period_s + rand() % 3;
+        }
+        int step = (rand() % 8 == 0) ? rand() % 10001 - value[probe] : rand() % 61 - 30;
+        int next = value[probe] + step;
+        value[probe] = (uint16_t)(next < 0 ? 0 : next > 10000 ? 10000 : next);
+        stream[i] = (history_sample_t) {
+            .time = time,
+            .probe = probe,
+            .centi_percent = value[probe],
+        };
+    }
+    return count;
+}
+
+/**
+ * @brief Decode every block in order.
+*/
+static size_t read_all(const history_t *history, history_sample_t *out, size_t max)
+{
+    size_t count = 0;
+
+    for (size_t b = 0; b < history_blocks(history); b++) {
+        count += history_read_block(history, b, out + count, max - count);
+    }
+    return count;
+}
+
+static bool same(const history_sample_t *a, const history_sample_t *b)
+{
+    return a->time == b->time && a->probe == b->probe && a->centi_percent == b->centi_percent;
+}
+
+static void test_round_trip(uint8_t probes)
+{
+    static uint8_t storage[256 * HISTORY_BLOCK_SIZE];
+    static history_sample_t out[STREAM_MAX];
+    history_t history = { 0 };
+    size_t count = make_stream(1500, probes, 20);
+
+    history_resume(&history, storage, sizeof(storage));
+    for (size_t i = 0; i < count; i++) {
+        history_append(&history, &stream[i]);
+    }
+
+    CHECK(history.dropped == 0, "%u samples dropped from a ring that fits them", (unsigned)history.dropped);
+    size_t read = read_all(&history, out, STREAM_MAX);
+    CHECK(read == count, "%u probes: read %zu of %zu samples", probes, read, count);
+    for (size_t i = 0; i < read && i < count; i++) {
+        if (!same(&out[i], &stream[i])) {
+            CHECK(false, "%u probes: sample %zu decoded as t=%u p=%u v=%u, wrote t=%u p=%u v=%u", probes, i,
+                  (unsigned)out[i].time, out[i].probe, out[i].centi_percent,
+                  (unsigned)stream[i].time, stream[i].probe, stream[i].centi_percent);
+            break;
+        }
+    }
+}
+
+static void test_extremes(void)
+{
+    static uint8_t storage[16 * HISTORY_BLOCK_SIZE];
+    history_sample_t out[64];
+    history_t history = { 0 };
+    // Full scale value swings, a huge time gap, and a clock stepping backwards
+    const history_sample_t samples[] = {
+        { .time = 0, .probe = 0, .centi_percent = 0 },
+        { .time = 1, .probe = 15, .centi_percent = 65535 },
+        { .time = 2, .probe = 15, .centi_percent = 0 },
+        { .time = 3, .probe = 0, .centi_percent = 65535 },
+        { .time = 0xfffffff0u, .probe = 7, .centi_percent = 1234 },
+        { .time = 0xfffffff0u, .probe = 7, .centi_percent = 1234 },
+        { .time = 100, .probe = 7, .centi_percent = 4321 },
+        { .time = 101, .probe = 3, .centi_percent = 10000 },
+    };
+    const size_t count = sizeof(samples) / sizeof(samples[0]);
+
+    history_resume(&history, storage, sizeof(storage));
+    for (size_t i = 0; i < count; i++) {
+        history_append(&history, &samples[i]);
+    }
+    size_t read = read_all(&history, out, 64);
+    CHECK(read == count, "read %zu of %zu extreme samples", read, count);
+    for (size_t i = 0; i < read && i < count; i++) {
+        CHECK(same(&out[i], &samples[i]), "extreme sample %zu did not round trip", i);
+    }
+
+    // Out of range probes are ignored
+    history_sample_t bad = { .time = 200, .probe = HISTORY_PROBES_MAX, .centi_percent = 1 };
+    history_append(&history, &bad);
+    CHECK(read_all(&history, out, 64) == count, "a sample for probe %d was stored", HISTORY_PROBES_MAX);
+}
+
+static void test_wrap(void)
+{
+    static uint8_t storage[4 * HISTORY_BLOCK_SIZE];
+    static history_sample_t out[STREAM_MAX];
+    history_t history = { 0 };
+    size_t count = make_stream(1000, 2, 20);
+
+    history_resume(&history, storage, sizeof(storage));
+    for (size_t i = 0; i < count; i++) {
+        history_append(&history, &stream[i]);
+    }
+
+    // The oldest blocks go whole, what is left is the newest run of samples
+    size_t read = read_all(&history, out, STREAM_MAX);
+    CHECK(history_blocks(&history) == 4, "%zu blocks used of 4", history_blocks(&history));
+    CHECK(read + history.dropped == count, "kept %zu + dropped %u != %zu written", read,
+          (unsigned)history.dropped, count);
+    for (size_t i = 0; i < read; i++) {
+        if (!same(&out[i], &stream[count - read + i])) {
+            CHECK(false, "sample %zu of the newest run did not round trip", i);
+            break;
+        }
+    }
+
+    size_t first_block = history_read_block(&history, 0, NULL, HISTORY_BLOCK_SAMPLES_MAX);
+    history_drop_oldest(&history, 1);
+    CHECK(read_all(&history, out, STREAM_MAX) == read - first_block, "drop_oldest did not release one block");
+    history_drop_oldest(&history, 10);
+    CHECK(history_blocks(&history) == 0 && history_bytes(&history) == 0, "dropping every block left data");
+}
+
+static void test_resume(void)
+{
+    static uint8_t storage[8 * HISTORY_BLOCK_SIZE];
+    static history_sample_t out[STREAM_MAX];
+    history_t history = { 0 };
+    size_t count = make_stream(40, 1, 20);
+
+    CHECK(!history_resume(&history, storage, sizeof(storage)), "a blank ring claimed to resume");
+    for (size_t i = 0; i < count; i++) {
+        history_append(&history, &stream[i]);
+    }
+    size_t bytes = history_bytes(&history);
+
+    // As after a deep sleep wake, RTC memory kept both the state and the storage
+    CHECK(history_resume(&history, storage, sizeof(storage)), "an intact ring was not resumed");
+    CHECK(history_bytes(&history) == bytes, "resume changed the stored bytes");
+    CHECK(read_all(&history, out, STREAM_MAX) == count, "resume lost samples");
+
+    // A different storage size means another build, start over
+    CHECK(!history_resume(&history, storage, sizeof(storage) / 2), "a resized ring was resumed");
+    CHECK(history_blocks(&history) == 0, "a resized ring kept its blocks");
+}
+
+int main(void)
+{
+    srand(14);
+    test_round_trip(1);
+    test_round_trip(4);
+    test_round_trip(HISTORY_PROBES_MAX);
+    test_extremes();
+    test_wrap();
+    test_resume();
+    return CHECK_DONE();
+}
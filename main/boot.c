@@ -0,0 +1,88 @@
+#include "boot.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+#include <freertos/FreeRTOS.h>
+
+static const char *phase_names[BOOT_PHASE_MAX] = {
+    [BOOT_APP_MAIN] = "app_main",
+    [BOOT_HARDWARE] = "hardware",
+    [BOOT_FIRST_SAMPLE] = "first sample",
+    [BOOT_WIFI_INIT] = "wifi init",
+    [BOOT_RAINMAKER_INIT] = "rainmaker init",
+    [BOOT_RAINMAKER_START] = "rainmaker start",
+    [BOOT_WIFI_CONNECTED] = "wifi connected",
+    [BOOT_MQTT_CONNECTED] = "mqtt connected",
+    [BOOT_FIRST_REPORT] = "first report",
+};
+
+// 0 marks a phase not reached yet, esp_timer is already running before app_main
+static int64_t phase_us[BOOT_PHASE_MAX];
+static portMUX_TYPE boot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *TAG = "BOOT";
+
+void boot_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_MAX) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool first = false;
+
+    portENTER_CRITICAL(&boot_lock);
+    if (phase_us[phase] == 0) {
+        phase_us[phase] = now;
+        first = true;
+    }
+    portEXIT_CRITICAL(&boot_lock);
+
+    if (first && phase == BOOT_FIRST_REPORT) {
+        boot_log();
+    }
+}
+
+int64_t boot_time_us(boot_phase_t phase)
+{
+    int64_t us;
+
+    if (phase >= BOOT_PHASE_MAX) {
+        return -1;
+    }
+    portENTER_CRITICAL(&boot_lock);
+    us = phase_us[phase];
+    portEXIT_CRITICAL(&boot_lock);
+    return us ? us : -1;
+}
+
+void boot_log(void)
+{
+    ESP_LOGI(TAG, "%-16s %10s", "phase", "ms");
+    for (int i = 0; i < BOOT_PHASE_MAX; i++) {
+        int64_t us = boot_time_us(i);
+        if (us < 0) {
+            ESP_LOGI(TAG, "%-16s %10s", phase_names[i], "-");
+        } else {
+            ESP_LOGI(TAG, "%-16s %10lu.%03lu", phase_names[i],
+                (unsigned long)(us / 1000), (unsigned long)(us % 1000));
+        }
+    }
+}
+
+static int boot_times_cmd(int argc, char **argv)
+{
+    boot_log();
+    return 0;
+}
+
+void boot_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "boot-times",
+        .help = "Time from power up to each boot phase, first sample and first report",
+        .func = boot_times_cmd,
+    };
+    esp_console_cmd_register(&cmd);
+}
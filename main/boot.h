@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// Boot milestones, each is timestamped the first time it is reached
+typedef enum {
+    BOOT_APP_MAIN = 0,
+    BOOT_HARDWARE,          // Devices, NVS and local control up
+    BOOT_FIRST_SAMPLE,
+    BOOT_WIFI_INIT,
+    BOOT_RAINMAKER_INIT,
+    BOOT_RAINMAKER_START,
+    BOOT_WIFI_CONNECTED,
+    BOOT_MQTT_CONNECTED,
+    BOOT_FIRST_REPORT,
+    BOOT_PHASE_MAX,
+} boot_phase_t;
+
+/**
+ * @brief Record the esp_timer time of a boot phase, later calls for the same phase are ignored.
+ * The table is logged once the first report has gone out.
+*/
+void boot_mark(boot_phase_t phase);
+
+/**
+ * @brief Microseconds since esp_timer started when `phase` was reached, -1 if not yet.
+*/
+int64_t boot_time_us(boot_phase_t phase);
+
+void boot_log(void);
+
+/**
+ * @brief Register the "boot-times" console command.
+ * Call after esp_rmaker_console_init().
+*/
+void boot_register_console(void);
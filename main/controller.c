@@ -0,0 +1,211 @@
+#include "controller.h"
+#include "device.h"
+#include "event_queue.h"
+#include "persist.h"
+#include "input.h"
+
+#include <esp_log.h>
+
+static controller_config_t config = {
+    .dry = MOISTURE_DRY,
+    .wet = MOISTURE_WET,
+    .min_on = pdMS_TO_TICKS(CONTROL_MIN_ON_S * 1000),
+    .min_off = pdMS_TO_TICKS(CONTROL_MIN_OFF_S * 1000),
+    .max_run = pdMS_TO_TICKS(CONTROL_MAX_RUN_S * 1000),
+};
+
+static const char *TAG = "CONTROL";
+
+#ifdef CONFIG_EXAMPLE_CONTROLLER
+// Tick of each pump's last on/off transition, indexed by registry id.
+// Written from whichever task switched the pump
+static TickType_t pump_since[DEVICE_MAX];
+static portMUX_TYPE control_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool led_dry = false;
+
+static void report_on_off(device_desc_t *dev)
+{
+    event_packet_t state_to_app = {
+        .direction = ESP_TO_APP,
+        .device = registry_id(dev),
+        .payload = PAYLOAD_ON_OFF,
+        .data.on_off = dev->on_off,
+    };
+    event_send(&state_to_app, PRODUCER_CONTROLLER);
+}
+
+static device_desc_t *pump_for_sensor(const device_desc_t *sensor)
+{
+    uint8_t instance = registry_instance(sensor);
+    device_desc_t *pump = NULL;
+
+    // Extra probes share the last pump
+    for (uint8_t i = 0; i <= instance; i++) {
+        device_desc_t *next = registry_find(DEVICE_PUMP, i);
+        if (!next) {
+            break;
+        }
+        pump = next;
+    }
+    return pump;
+}
+
+void controller_pump_changed(device_desc_t *pump)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    portENTER_CRITICAL(&control_lock);
+    pump_since[registry_id(pump)] = now;
+    portEXIT_CRITICAL(&control_lock);
+
+    // A pump just switched on needs its max run time scheduled by the consumer
+    event_queue_wake();
+}
+
+/**
+ * @brief Time since the pump last switched, whoever switched it.
+*/
+static TickType_t pump_elapsed(device_desc_t *pump, TickType_t now)
+{
+    portENTER_CRITICAL(&control_lock);
+    TickType_t since = pump_since[registry_id(pump)];
+    portEXIT_CRITICAL(&control_lock);
+    return now - since;
+}
+
+static void pump_switch(device_desc_t *pump, bool on)
+{
+    // set_pump() restarts the pump's timing through controller_pump_changed()
+    set_pump(pump, on);
+    report_on_off(pump);
+    ESP_LOGI(TAG, "%s %s", pump->name, on ? "on" : "off");
+}
+
+static void sensor_set_pump(device_desc_t *pump, float driest)
+{
+    TickType_t elapsed = pump_elapsed(pump, xTaskGetTickCount());
+
+    // Hysteresis band between wet and dry keeps the current state, a low reservoir keeps it off
+    if (!pump->on_off && driest >= config.dry && elapsed >= config.min_off && !input_water_low()) {
+        pump_switch(pump, true);
+    } else if (pump->on_off && driest <= config.wet && elapsed >= config.min_on) {
+        pump_switch(pump, false);
+    }
+}
+
+static void sensor_set_led(float driest)
+{
+    device_desc_t *led = registry_find(DEVICE_LED, 0);
+
+    // LED lights up while any bed is dry, same hysteresis as the pumps
+    bool was_dry = led_dry;
+    if (!led_dry && driest >= config.dry) {
+        led_dry = true;
+    } else if (led_dry && driest <= config.wet) {
+        led_dry = false;
+    }
+
+    // Colour follows the driest bed, cheap as the driver drops unchanged writes
+    status_led_set_status(led_dry ? LED_STATUS_DRY : (driest <= config.wet) ? LED_STATUS_WET : LED_STATUS_OK);
+    if (led_dry == was_dry) {
+        return;
+    }
+
+    if (led && led->on_off != led_dry) {
+        led->on_off = led_dry;
+        set_onBoard_led(led_dry);
+        report_on_off(led);
+    }
+}
+
+void controller_update(device_desc_t *sensor)
+{
+    device_desc_t *pump = pump_for_sensor(sensor);
+    float driest_bed = sensor->reading;
+    float driest_node = sensor->reading;
+
+    // Driest probe on the same pump, and driest probe overall for the LED
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+        if (dev->type != DEVICE_SENSOR) {
+            continue;
+        }
+        if (dev->reading > driest_node) {
+            driest_node = dev->reading;
+        }
+        if (pump && pump_for_sensor(dev) == pump && dev->reading > driest_bed) {
+            driest_bed = dev->reading;
+        }
+    }
+
+    if (pump) {
+        sensor_set_pump(pump, driest_bed);
+    }
+    sensor_set_led(driest_node);
+}
+
+TickType_t controller_poll(void)
+{
+    TickType_t wait = portMAX_DELAY;
+    TickType_t now = xTaskGetTickCount();
+
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *pump = registry_get(id);
+        if (pump->type != DEVICE_PUMP) {
+            continue;
+        }
+
+        if (!pump->on_off) {
+            continue;
+        }
+
+        TickType_t elapsed = pump_elapsed(pump, now);
+        if (elapsed >= config.max_run) {
+            ESP_LOGW(TAG, "%s reached its maximum run time", pump->name);
+            pump_switch(pump, false);
+        } else if (config.max_run - elapsed < wait) {
+            wait = config.max_run - elapsed;
+        }
+    }
+    return wait;
+}
+#else
+void controller_pump_changed(device_desc_t *pump)
+{
+}
+
+void controller_update(device_desc_t *sensor)
+{
+}
+
+TickType_t controller_poll(void)
+{
+    return portMAX_DELAY;
+}
+#endif
+
+bool controller_watering(void)
+{
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+        if (dev->type == DEVICE_PUMP && dev->on_off) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void controller_get_config(controller_config_t *out)
+{
+    *out = config;
+}
+
+void controller_set_config(const controller_config_t *in)
+{
+    if (in->wet >= in->dry) {
+        ESP_LOGE(TAG, "Wet threshold must be below the dry threshold");
+        return;
+    }
+    config = *in;
+    persist_mark_dirty(PERSIST_STATE);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+
+#include "registry.h"
+
+#ifdef CONFIG_EXAMPLE_CONTROLLER
+#define CONTROL_MIN_ON_S    CONFIG_EXAMPLE_CONTROL_MIN_ON_S
+#define CONTROL_MIN_OFF_S   CONFIG_EXAMPLE_CONTROL_MIN_OFF_S
+#define CONTROL_MAX_RUN_S   CONFIG_EXAMPLE_CONTROL_MAX_RUN_S
+#else
+#define CONTROL_MIN_ON_S    10
+#define CONTROL_MIN_OFF_S   60
+#define CONTROL_MAX_RUN_S   120
+#endif
+
+// Thresholds and timing of the local irrigation loop
+typedef struct {
+    float dry;              // Pump on at or above this reading
+    float wet;              // Pump off at or below this reading
+    TickType_t min_on;
+    TickType_t min_off;
+    TickType_t max_run;     // Forced off after this long, then held off for min_off
+} controller_config_t;
+
+/**
+ * @brief Run the control loop for the pump fed by `sensor`, right after it was sampled.
+ *
+ * Probe n waters pump n, extra probes share the last pump. With several probes
+ * on one pump the driest of them decides. Works without any network connection.
+*/
+void controller_update(device_desc_t *sensor);
+
+/**
+ * @brief Note that a pump switched on or off, called by set_pump() and stop_pump().
+ *
+ * Min on/off times only hold back the controller's own switching, counted from
+ * the last change whoever made it. App and button commands apply at once.
+ * Safe to call from any task.
+*/
+void controller_pump_changed(device_desc_t *pump);
+
+/**
+ * @brief Enforce the max run time of every pump, whoever switched it on.
+ * Called from the event consumer.
+ *
+ * @return ticks until the next limit expires, portMAX_DELAY if none is pending
+*/
+TickType_t controller_poll(void);
+
+/**
+ * @brief Whether any pump is running, whoever switched it on.
+*/
+bool controller_watering(void);
+
+void controller_get_config(controller_config_t *config);
+void controller_set_config(const controller_config_t *config);
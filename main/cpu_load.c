@@ -0,0 +1,114 @@
+#include "cpu_load.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_console.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char *TAG = "CPU";
+
+#if defined(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS) && defined(CONFIG_FREERTOS_USE_TRACE_FACILITY)
+typedef struct {
+    TaskStatus_t tasks[CPU_LOAD_MAX_TASKS];
+    UBaseType_t count;
+    uint32_t total;
+} cpu_snapshot_t;
+
+static const TaskStatus_t *snapshot_find(const cpu_snapshot_t *snap, TaskHandle_t handle)
+{
+    for (UBaseType_t i = 0; i < snap->count; i++) {
+        if (snap->tasks[i].xHandle == handle) {
+            return &snap->tasks[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Core an idle task belongs to, from its IDLE<n> name, -1 for other tasks.
+*/
+static int idle_core(const TaskStatus_t *task)
+{
+    const char *name = task->pcTaskName;
+
+    if (strncmp(name, "IDLE", 4) == 0 && name[4] >= '0' && name[4] < '0' + portNUM_PROCESSORS) {
+        return name[4] - '0';
+    }
+    return -1;
+}
+
+void cpu_load_log(uint32_t window_ms)
+{
+    cpu_snapshot_t *snaps = malloc(2 * sizeof(cpu_snapshot_t));
+    if (!snaps) {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+
+    snaps[0].count = uxTaskGetSystemState(snaps[0].tasks, CPU_LOAD_MAX_TASKS, &snaps[0].total);
+    vTaskDelay(pdMS_TO_TICKS(window_ms));
+    snaps[1].count = uxTaskGetSystemState(snaps[1].tasks, CPU_LOAD_MAX_TASKS, &snaps[1].total);
+
+    // Run time counters tick on every core, so each core has `elapsed` to give out
+    uint32_t elapsed = snaps[1].total - snaps[0].total;
+    if (snaps[0].count == 0 || snaps[1].count == 0 || elapsed == 0) {
+        ESP_LOGE(TAG, "Too many tasks to sample, raise CPU_LOAD_MAX_TASKS");
+        free(snaps);
+        return;
+    }
+
+    uint32_t idle[portNUM_PROCESSORS] = {0};
+    ESP_LOGI(TAG, "%-16s %4s %6s %6s", "task", "core", "load%", "stack");
+    for (UBaseType_t i = 0; i < snaps[1].count; i++) {
+        const TaskStatus_t *now = &snaps[1].tasks[i];
+        const TaskStatus_t *before = snapshot_find(&snaps[0], now->xHandle);
+        uint32_t ran = now->ulRunTimeCounter - (before ? before->ulRunTimeCounter : 0);
+        int core = idle_core(now);
+
+        if (core >= 0) {
+            idle[core] += ran;
+        }
+#ifdef CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        int affinity = (now->xCoreID < portNUM_PROCESSORS) ? (int)now->xCoreID : -1;
+#else
+        int affinity = -1;
+#endif
+        ESP_LOGI(TAG, "%-16s %4s %5lu.%lu %6lu", now->pcTaskName,
+            affinity < 0 ? "any" : affinity == 0 ? "0" : "1",
+            (unsigned long)(ran * 100ULL / elapsed), (unsigned long)(ran * 1000ULL / elapsed % 10),
+            (unsigned long)now->usStackHighWaterMark);
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        uint32_t busy = (idle[core] < elapsed) ? elapsed - idle[core] : 0;
+        ESP_LOGI(TAG, "Core %d load %lu%% over %lu ms", core,
+            (unsigned long)(busy * 100ULL / elapsed), (unsigned long)window_ms);
+    }
+    free(snaps);
+}
+#else
+void cpu_load_log(uint32_t window_ms)
+{
+    ESP_LOGW(TAG, "Enable CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and CONFIG_FREERTOS_USE_TRACE_FACILITY");
+}
+#endif
+
+static int cpu_load_cmd(int argc, char **argv)
+{
+    uint32_t window_ms = (argc > 1) ? strtoul(argv[1], NULL, 10) : CPU_LOAD_WINDOW_MS;
+
+    cpu_load_log(window_ms ? window_ms : CPU_LOAD_WINDOW_MS);
+    return 0;
+}
+
+void cpu_load_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "cpu-load",
+        .help = "Per-core load and per-task run time over a window, optional window in ms",
+        .func = cpu_load_cmd,
+    };
+    esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <sdkconfig.h>
+
+// Tasks sampled per snapshot and the default measurement window
+#define CPU_LOAD_MAX_TASKS  40
+#define CPU_LOAD_WINDOW_MS  1000
+
+/**
+ * @brief Measure per-core and per-task CPU load over `window_ms` and log it.
+ * Blocks the caller for the window, needs FreeRTOS run time stats.
+*/
+void cpu_load_log(uint32_t window_ms);
+
+/**
+ * @brief Register the "cpu-load" console command.
+ * Call after esp_rmaker_console_init().
+*/
+void cpu_load_register_console(void);
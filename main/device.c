@@ -1,71 +1,94 @@
 #include "device.h"
+#include "event_queue.h"
+#include "power.h"
+#include "persist.h"
+#include "input.h"
+#include "controller.h"
+#include "sensor.h"
+#include "hal.h"
+#include "dlog.h"
+
+#include <esp_log.h>
+#include <freertos/semphr.h>
 
-#include <stdlib.h>
+static bool current_led_state = false;
 
-// RTOS items
-static TimerHandle_t sensor_timer;
-extern QueueHandle_t event_queue;
+static const char *TAG = "DEVICE";
 
-static bool current_led_state = false;
-static float current_temperature = 0.0;
-static bool current_pump_state = false;
+// Makes the low water check and the pump write one step, see stop_pump()
+static SemaphoreHandle_t pump_mutex;
+static StaticSemaphore_t pump_mutex_buffer;
 
-static adc_oneshot_unit_handle_t adc_handle;
-static adc_cali_handle_t adc_cali_handle;
+static esp_err_t led_init(device_desc_t *dev);
+static esp_err_t water_pump_init(device_desc_t *dev);
+static void led_apply(device_desc_t *dev, const event_packet_t *event);
+static void pump_apply(device_desc_t *dev, const event_packet_t *event);
 
-static const char *TAG = "DEVICE";
+const device_hw_ops_t led_hw_ops = {
+    .init = led_init,
+    .apply = led_apply,
+};
 
-esp_err_t water_pump_init(bool initial_state);
-esp_err_t sensor_init(float initial_reading);
-static void push_btn_callback(void *arg);
-void sensor_set_led(int sensor_reading);
-void sensor_set_pump(int sensor_reading);
+const device_hw_ops_t pump_hw_ops = {
+    .init = water_pump_init,
+    .apply = pump_apply,
+};
 
-void hardware_init(bool initial_onoff_state, float initial_sensor_reading)
+void storage_init(void)
 {
-    // Configure boot button
-    button_handle_t btn_handle = iot_button_create(BUTTON_GPIO, BUTTON_ACTIVE_LEVEL);
+    static bool ready = false;
 
-    if (btn_handle) {
-        /* Register a callback for a button tap (short press) event */
-        iot_button_set_evt_cb(btn_handle, BUTTON_CB_TAP, push_btn_callback, NULL);
-        /* Register Wi-Fi reset and factory reset functionality on same button */
-        app_reset_button_register(btn_handle, WIFI_RESET_BUTTON_TIMEOUT, FACTORY_RESET_BUTTON_TIMEOUT);
+    if (ready) {
+        return;
     }
+    ESP_ERROR_CHECK(hal_storage_init());
+    ready = true;
+}
 
+void hardware_init(bool initial_onoff_state, float initial_sensor_reading)
+{
+    power_init();
+    storage_init();
+    persist_init();
+
+    // Configure every registered device with its initial state
+    pump_mutex = xSemaphoreCreateMutexStatic(&pump_mutex_buffer);
+    registry_init();
+    // Inputs first, the boot button and its reset holds included. A low reservoir keeps restored pumps off
+    input_init();
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+
+        dev->on_off = initial_onoff_state;
+        dev->reading = initial_sensor_reading;
+        // Saved state from before the reset, RTC state is newer after deep sleep
+        persist_restore(dev);
+        power_restore(dev);
+        if (dev->hw->init(dev) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not initialise %s", dev->name);
+        }
+    }
+    persist_start();
+    // Let the event consumer schedule run limits and writes for the restored state
+    event_queue_wake();
 
-    // Configure on board led
-    ws2812_led_init();
-    set_onBoard_led(initial_onoff_state);
-
-    #ifdef CONFIG_EXAMPLE_ENABLE_PUMP
-    // Configure water pump
-    water_pump_init(initial_onoff_state);
-    #endif
-
-    #ifdef CONFIG_EXAMPLE_ENABLE_SENSOR
-    // Configure sensor and timer to update at a regular interval
-    sensor_init(initial_sensor_reading);
-    #endif
+    // A wake from deep sleep is there to take a sample, do not wait a full period
+    if (power_resumed()) {
+        sensor_request_sample();
+    }
 }
 
-void hardware_update(event_packet_t event)
+void hardware_update(const event_packet_t *event)
 {
-    switch (event.device) {
-        case DEVICE_LED:
-            set_onBoard_led(event.data_on_off);
-            break;
-        case DEVICE_PUMP:
-            set_pump(event.data_on_off);
-            break;
-        case DEVICE_SENSOR:
-            // Do nothing
-            break;
-        default:
-            ESP_LOGE(TAG, "Unknown device type");
-            break;
-    }
-    return;
+    device_desc_t *dev = registry_get(event->device);
+
+    if (!dev) {
+        ESP_LOGE(TAG, "Unknown device id %d", event->device);
+        return;
+    }
+    if (dev->hw->apply) {
+        dev->hw->apply(dev, event);
+    }
 }
 
 
@@ -73,162 +96,200 @@ void hardware_update(event_packet_t event)
  * On Board LED functions
 ******************************************************/
 /** 
- * @brief Callback for boot button press
+ * @brief Boot button tap
  * 
 */
-static void push_btn_callback(void *arg)
+void toggle_onBoard_led(void)
 {
+    device_desc_t *led = registry_find(DEVICE_LED, 0);
+
     // Note that the global variable current_led_state is modified throught the function
     set_onBoard_led(!current_led_state);
+    led->on_off = current_led_state;
+    persist_mark_dirty(PERSIST_STATE);
 
     event_packet_t led_data_to_app = {
         .direction = ESP_TO_APP,
-        .device = DEVICE_LED,
-        .data_on_off = current_led_state,
+        .device = registry_id(led),
+        .payload = PAYLOAD_ON_OFF,
+        .data.on_off = current_led_state,
     };
 
-    xQueueSend(event_queue, &led_data_to_app, 0);
+    event_send(&led_data_to_app, PRODUCER_BUTTON);
 }
 
 void set_onBoard_led(bool isLedOn)
 {   
     current_led_state = isLedOn;
+    // The driver skips the write when the colour does not change
+    status_led_set_power(isLedOn);
+}
 
-    if (isLedOn) {
-        ws2812_led_set_rgb(DEFAULT_RED, DEFAULT_GREEN, DEFAULT_BLUE);
-    } else {
-        ws2812_led_clear();
+static esp_err_t led_init(device_desc_t *dev)
+{
+    // Configure on board led
+    status_led_init();
+    status_led_set_brightness(dev->level);
+    set_onBoard_led(dev->on_off);
+    return ESP_OK;
+}
+
+static void led_apply(device_desc_t *dev, const event_packet_t *event)
+{
+    if (event->payload == PAYLOAD_ON_OFF) {
+        DLOGI(DLOG_TAG_DEVICE, TAG, "%s set %s", dev->name, event->data.on_off ? "on" : "off");
+        dev->on_off = event->data.on_off;
+        set_onBoard_led(dev->on_off);
+    } else if (event->payload == PAYLOAD_LEVEL) {
+        DLOGI(DLOG_TAG_DEVICE, TAG, "%s brightness %d", dev->name, event->data.level);
+        dev->level = event->data.level;
+        status_led_set_brightness(dev->level);
     }
+    persist_mark_dirty(PERSIST_STATE);
 }
 
 /******************************************************
  * Water Pump Functions
 ******************************************************/
  
-void set_pump(bool isPumpOn)
-{
-    current_pump_state = isPumpOn; 
-
-    if (isPumpOn) {
-        gpio_set_level(RELAY_GPIO, RELAY_ACTIVE_LEVEL);
-    } else {
-        gpio_set_level(RELAY_GPIO, 1 - RELAY_ACTIVE_LEVEL);
-    }
-}
+#ifdef CONFIG_EXAMPLE_PUMP_PWM
+// Pumps whose PWM channel is up, the others are switched as relays. Indexed by registry id
+static bool pump_pwm[DEVICE_MAX];
 
-esp_err_t water_pump_init(bool initial_state)
+/**
+ * @brief Duty for a speed setting, speeds 1 to PUMP_SPEED_MAX spread from PUMP_MIN_DUTY to full.
+*/
+static uint16_t pump_duty(const device_desc_t *pump)
 {
-    // Configure GPIO for water pump control
-    gpio_config_t io_conf = {
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .pin_bit_mask = ((uint64_t)1 << RELAY_GPIO),
-    };
-    gpio_config(&io_conf);
+    uint8_t speed = (pump->level > PUMP_SPEED_MAX) ? PUMP_SPEED_MAX : pump->level;
 
-    return ESP_OK;
+    if (!pump->on_off || speed == 0) {
+        return 0;
+    }
+    uint32_t min = PUMP_MIN_DUTY * HAL_PWM_DUTY_MAX / 100;
+    return (uint16_t)(min + (HAL_PWM_DUTY_MAX - min) * (speed - 1) / (PUMP_SPEED_MAX > 1 ? PUMP_SPEED_MAX - 1 : 1));
 }
+#endif
 
-/******************************************************
- * Sensor functions
-******************************************************/
-
-int map_range(int x, int in_min, int in_max, int out_min, int out_max)
+/**
+ * @brief Bring the pump output in line with its on/off state and speed.
+*/
+static void pump_output(device_desc_t *pump)
 {
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+#ifdef CONFIG_EXAMPLE_PUMP_PWM
+    if (pump_pwm[registry_id(pump)]) {
+        // LEDC steps the duty itself, no timer or task runs during the ramp
+        hal_pwm_fade(registry_instance(pump), pump_duty(pump), PUMP_RAMP_MS);
+        return;
+    }
+#endif
+    if (pump->on_off) {
+        hal_gpio_write(pump->gpio, RELAY_ACTIVE_LEVEL);
+    } else {
+        hal_gpio_write(pump->gpio, 1 - RELAY_ACTIVE_LEVEL);
+    }
 }
 
-float get_sensor_reading(void)
+void set_pump(device_desc_t *pump, bool isPumpOn)
 {
-    // Hint: Something feels off here hmmmmm
-    int rand_num = rand() % 20;
-    return (float)(rand_num + 60);
-
-    // Provide power to Sensor
-    gpio_set_level(SENSOR_GPIO, 1);
-    // Let value stabilize
-    vTaskDelay(100 / portTICK_PERIOD_MS); 
-    // Read values
-    int raw_value = -1;
-    adc_oneshot_read(adc_handle, ADC_PIN, &raw_value);
-    int sensor_val = map_range(raw_value, 0, ADC_RAW_MAX, 0, SENSOR_RANGE);
-    // ESP_LOGI(TAG, "Raw ADC value: %d, mapped sensor value: %d", raw_value, sensor_val);
-    // Turn off power to sensor
-    gpio_set_level(SENSOR_GPIO, 0);
-    return sensor_val;
+    xSemaphoreTake(pump_mutex, portMAX_DELAY);
+    // A low reservoir overrides every request to run
+    if (isPumpOn && input_water_low()) {
+        ESP_LOGW(TAG, "%s held off, water is low", pump->name);
+        isPumpOn = false;
+    }
+    bool changed = (pump->on_off != isPumpOn);
+    pump->on_off = isPumpOn; 
+    pump_output(pump);
+    if (changed) {
+        // Min on/off and max run times count from here, whoever switched it
+        controller_pump_changed(pump);
+    }
+    xSemaphoreGive(pump_mutex);
+    persist_mark_dirty(PERSIST_STATE);
 }
 
-static void sensor_update(TimerHandle_t handle)
+bool stop_pump(device_desc_t *pump)
 {
-    float reading = get_sensor_reading();
-
-    event_packet_t sensor_data_to_app = {
-        .direction = ESP_TO_APP,
-        .device = DEVICE_SENSOR,
-        .data_sensor = reading,
-    };
+    // A set_pump() past its water check finishes first, then it is switched off here
+    xSemaphoreTake(pump_mutex, portMAX_DELAY);
+    bool was_on = pump->on_off;
+    if (was_on) {
+        pump->on_off = false;
+        pump_output(pump);
+        controller_pump_changed(pump);
+    }
+    xSemaphoreGive(pump_mutex);
 
-    xQueueSend(event_queue, &sensor_data_to_app, 0);
+    if (was_on) {
+        persist_mark_dirty(PERSIST_STATE);
+    }
+    return was_on;
 }
 
-void sensor_set_led(int sensor_reading)
+void pump_prepare_sleep(device_desc_t *pump)
 {
-    return;
-    // TODO: insert how to control LED based on sensor reading
-    // Hint: can use MOISTURE_DRY and MOISTURE_WET from device.h
+#ifdef CONFIG_EXAMPLE_PUMP_PWM
+    if (pump_pwm[registry_id(pump)]) {
+        hal_pwm_stop(registry_instance(pump));
+        return;
+    }
+#endif
+    hal_gpio_write(pump->gpio, 1 - RELAY_ACTIVE_LEVEL);
 }
 
-void sensor_set_pump(int sensor_reading)
+static esp_err_t water_pump_init(device_desc_t *dev)
 {
-    return;
-    // TODO: insert how to control pump based on sensor reading
-    // Hint: can use MOISTURE_DRY and MOISTURE_WET from device.h
+    bool relay = true;
+
+#ifdef CONFIG_EXAMPLE_PUMP_PWM
+    // One LEDC channel per pump instance, starting stopped so a restored state soft starts
+    esp_err_t err = hal_pwm_init(registry_instance(dev), dev->gpio, PUMP_PWM_FREQ_HZ, !RELAY_ACTIVE_LEVEL);
+    relay = (err != ESP_OK);
+    pump_pwm[registry_id(dev)] = !relay;
+    if (relay) {
+        ESP_LOGW(TAG, "%s: no PWM (%s), switching as a relay", dev->name, esp_err_to_name(err));
+    }
+#endif
+    if (relay) {
+        // Configure GPIO for water pump control
+        hal_gpio_output(dev->gpio, true);
+    }
+    bool restored_on = dev->on_off;
+    set_pump(dev, dev->on_off);
+    if (restored_on && dev->on_off) {
+        // Restored running, set_pump() saw no change but the run and its max run time start here
+        controller_pump_changed(dev);
+    }
+    // Relays are latched off through deep sleep, hand the pad back to the driver
+    hal_gpio_hold(dev->gpio, false);
+
+    return ESP_OK;
 }
 
-esp_err_t sensor_init(float initial_reading)
+static void pump_apply(device_desc_t *dev, const event_packet_t *event)
 {
-    // Digital output to control sensor power
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .pin_bit_mask = ((uint64_t)1 << SENSOR_GPIO),
-    };
-    gpio_config(&io_conf);
-
-    // ADC for analog read
-    adc_oneshot_unit_init_cfg_t adc_config = {
-        .unit_id = ADC_UNIT,
-    };
-
-    adc_oneshot_new_unit(&adc_config, &adc_handle);
-
-    adc_oneshot_chan_cfg_t channel_config = {
-        .bitwidth = ADC_BITWIDTH,
-        .atten = ADC_ATTEN,
-    };
-
-    adc_oneshot_config_channel(adc_handle, ADC_PIN, &channel_config);
-
-    adc_cali_curve_fitting_config_t cali_config = {
-        .unit_id = ADC_UNIT,
-        .atten = ADC_ATTEN,
-        .bitwidth = ADC_BITWIDTH,
-    };
-
-    adc_cali_create_scheme_curve_fitting(&cali_config, &adc_cali_handle);
-
-    // Start timer to trigger every reporting interval 
-    current_temperature = initial_reading;
-
-    sensor_timer = xTimerCreate("sensor_update_tm", (REPORTING_PERIOD * 1000) / portTICK_PERIOD_MS,
-                            pdTRUE, NULL, sensor_update);
-    if (sensor_timer) {
-        xTimerStart(sensor_timer, 0);
-        return ESP_OK;
+    if (event->payload == PAYLOAD_ON_OFF) {
+        DLOGI(DLOG_TAG_DEVICE, TAG, "%s set %s", dev->name, event->data.on_off ? "on" : "off");
+        set_pump(dev, event->data.on_off);
+        if (dev->on_off != event->data.on_off) {
+            // Refused for low water, put the app's switch back
+            event_packet_t state_to_app = {
+                .direction = ESP_TO_APP,
+                .device = registry_id(dev),
+                .payload = PAYLOAD_ON_OFF,
+                .data.on_off = dev->on_off,
+            };
+            event_send(&state_to_app, PRODUCER_INPUT);
+        }
+    } else if (event->payload == PAYLOAD_LEVEL) {
+        // A relay has no speed control, it only keeps the setpoint for reporting.
+        // Under the mutex, a stop_pump() for low water must not be undone by the speed write
+        xSemaphoreTake(pump_mutex, portMAX_DELAY);
+        dev->level = (event->data.level > PUMP_SPEED_MAX) ? PUMP_SPEED_MAX : event->data.level;
+        pump_output(dev);
+        xSemaphoreGive(pump_mutex);
+        DLOGI(DLOG_TAG_DEVICE, TAG, "%s speed %d", dev->name, dev->level);
+        persist_mark_dirty(PERSIST_STATE);
     }
-    return ESP_FAIL;
 }
-
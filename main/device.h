@@ -4,22 +4,11 @@
 #include <stdbool.h>
 #include <sdkconfig.h>
 
-#include "esp_log.h"
 #include <freertos/FreeRTOS.h>
-#include <freertos/timers.h>
-
-#include "esp_timer.h"
-#include "esp_adc/adc_oneshot.h"
-#include "esp_adc/adc_cali.h"
-#include "esp_adc/adc_cali_scheme.h"
-#include "esp_intr_alloc.h"
-#include "driver/gpio.h"
-
-#include <iot_button.h>
-#include <ws2812_led.h>
-#include <app_reset.h>
 
 #include "packet.h"
+#include "registry.h"
+#include "status_led.h"
 
 #define DEFAULT_SWITCH_POWER        true
 #define DEFAULT_LIGHT_POWER         true
@@ -27,20 +16,32 @@
 #define DEFAULT_FAN_POWER           false
 #define DEFAULT_FAN_SPEED           3
 #define DEFAULT_TEMPERATURE         80
-#define REPORTING_PERIOD            20 /* In seconds */
+#ifdef CONFIG_EXAMPLE_ENABLE_SENSOR
+#define SAMPLE_PERIOD_MIN_S         CONFIG_EXAMPLE_SAMPLE_PERIOD_MIN_S /* In seconds */
+#define SAMPLE_PERIOD_MAX_S         CONFIG_EXAMPLE_SAMPLE_PERIOD_MAX_S /* In seconds */
+#define REPORTING_PERIOD            CONFIG_EXAMPLE_REPORT_PERIOD_S /* In seconds, minimum between reports */
+#else
+#define SAMPLE_PERIOD_MIN_S         5
+#define SAMPLE_PERIOD_MAX_S         600
+#define REPORTING_PERIOD            20
+#endif
+
+// Core placement of our own tasks, networking keeps the protocol core to itself
+#ifdef CONFIG_EXAMPLE_TASK_CORE_APP
+#define APP_TASK_CORE       1 /* APP_CPU_NUM */
+#define NETWORK_TASK_CORE   0 /* PRO_CPU_NUM */
+#else
+#define APP_TASK_CORE       tskNO_AFFINITY
+#define NETWORK_TASK_CORE   tskNO_AFFINITY
+#endif
 
 /* This is the button that is used for toggling the power */
 #define BUTTON_GPIO          CONFIG_EXAMPLE_BOARD_BUTTON_GPIO
 #define BUTTON_ACTIVE_LEVEL  0
-/* This is the GPIO on which the power will be set */
-#define SENSOR_GPIO    CONFIG_EXAMPLE_SENSOR_POWER_GPIO
 
-#define ADC_UNIT  ADC_UNIT_1
-#define ADC_PIN ADC_CHANNEL_0
-#define ADC_ATTEN ADC_ATTEN_DB_11
-#define ADC_BITWIDTH ADC_BITWIDTH_DEFAULT
 #define ADC_RAW_MAX (4095)
 #define SENSOR_RANGE (100)
+#define SENSOR_SETTLE_MS (100) /* Probe power-up time before a valid read */
 
 // Value boundaries for moisture sensor
 // The higher, the drier
@@ -50,19 +51,47 @@
 #define RELAY_GPIO CONFIG_EXAMPLE_RELAY_GPIO
 #define RELAY_ACTIVE_LEVEL 1
 
-/* These values correspoind to H,S,V = 120,100,10 */
-#define DEFAULT_RED     0
-#define DEFAULT_GREEN   25
-#define DEFAULT_BLUE    0
+// Range of the RainMaker speed param, speed 0 keeps the pump stopped
+#define PUMP_SPEED_MAX 5
+
+#ifdef CONFIG_EXAMPLE_PUMP_PWM
+#define PUMP_PWM_FREQ_HZ CONFIG_EXAMPLE_PUMP_PWM_FREQ_HZ
+#define PUMP_RAMP_MS CONFIG_EXAMPLE_PUMP_RAMP_MS
+#define PUMP_MIN_DUTY CONFIG_EXAMPLE_PUMP_MIN_DUTY
+#endif
 
-/* To reset & display QR code after reset*/
+/* Boot button hold in seconds to reset & display QR code after reset, see input.c */
 #define WIFI_RESET_BUTTON_TIMEOUT       3
 #define FACTORY_RESET_BUTTON_TIMEOUT    10
 
+// Hardware ops referenced by the device registry
+extern const device_hw_ops_t led_hw_ops;
+extern const device_hw_ops_t pump_hw_ops;
+
+/**
+ * @brief Bring up the default NVS partition, erasing it if its layout is stale. Safe to call again.
+*/
+void storage_init(void);
+
 void hardware_init(bool initial_onoff_state, float initial_sensor_reading);
 
-void hardware_update(event_packet_t event);
+void hardware_update(const event_packet_t *event);
 
 void set_onBoard_led(bool isLedOn);
-void set_pump(bool isPumpOn);
-float get_sensor_reading(void);
+void toggle_onBoard_led(void);
+void set_pump(device_desc_t *pump, bool isPumpOn);
+
+/**
+ * @brief Switch a pump off, for the low water cutoff.
+ *
+ * Serialised with set_pump(), once input_water_low() reports low water no
+ * start can slip in after this.
+ *
+ * @return whether the pump was running
+*/
+bool stop_pump(device_desc_t *pump);
+
+/**
+ * @brief Switch a pump's output off at once, skipping any ramp, so the pad can be latched for deep sleep.
+*/
+void pump_prepare_sleep(device_desc_t *pump);
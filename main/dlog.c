@@ -0,0 +1,214 @@
+#include "dlog.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <esp_console.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char *tag_names[DLOG_TAG_MAX] = {
+    [DLOG_TAG_MAIN] = "MAIN",
+    [DLOG_TAG_DEVICE] = "DEVICE",
+    [DLOG_TAG_RAINMAKER] = "rainMaker",
+};
+
+static const char *TAG = "DLOG";
+
+#ifdef CONFIG_EXAMPLE_DLOG
+_Static_assert((DLOG_RING_SIZE & (DLOG_RING_SIZE - 1)) == 0, "Ring size must be a power of two");
+
+// Bounded MPSC ring, a slot's sequence number tells whose turn it is:
+// seq == pos free for the producer claiming pos, seq == pos + 1 ready for the drain task
+typedef struct {
+    atomic_uint seq;
+    uint32_t time_ms;
+    const char *fmt;
+    uint8_t tag;
+    uint8_t level;
+    uint8_t argc;
+    uint32_t args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+static dlog_record_t ring[DLOG_RING_SIZE];
+static atomic_uint head;
+static uint32_t tail;           // Drain task only
+static atomic_uint dropped;
+
+static bool deferred[DLOG_TAG_MAX] = {
+#ifdef CONFIG_EXAMPLE_DLOG_MAIN
+    [DLOG_TAG_MAIN] = true,
+#endif
+#ifdef CONFIG_EXAMPLE_DLOG_DEVICE
+    [DLOG_TAG_DEVICE] = true,
+#endif
+#ifdef CONFIG_EXAMPLE_DLOG_RAINMAKER
+    [DLOG_TAG_RAINMAKER] = true,
+#endif
+};
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+static StackType_t dlog_task_stack[DLOG_TASK_STACK];
+static StaticTask_t dlog_task_buffer;
+#endif
+
+/**
+ * @brief Seed the slot sequence numbers, zeroed storage already matches.
+*/
+static void dlog_ring_reset(void)
+{
+    for (uint32_t i = 0; i < DLOG_RING_SIZE; i++) {
+        atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+    }
+}
+
+void dlog_write(dlog_tag_t tag, esp_log_level_t level, const char *fmt, int argc, ...)
+{
+    unsigned pos = atomic_load_explicit(&head, memory_order_relaxed);
+    dlog_record_t *record;
+
+    while (true) {
+        record = &ring[pos & (DLOG_RING_SIZE - 1)];
+        int diff = (int)(atomic_load_explicit(&record->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full, the drain task has not freed this slot yet
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+        }
+    }
+
+    va_list ap;
+    va_start(ap, argc);
+    for (int i = 0; i < argc && i < DLOG_MAX_ARGS; i++) {
+        record->args[i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    record->time_ms = esp_log_timestamp();
+    record->fmt = fmt;
+    record->tag = tag;
+    record->level = level;
+    record->argc = argc;
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+}
+
+static bool dlog_drain_one(void)
+{
+    dlog_record_t *record = &ring[tail & (DLOG_RING_SIZE - 1)];
+    char line[128];
+
+    if (atomic_load_explicit(&record->seq, memory_order_acquire) != tail + 1) {
+        return false;
+    }
+
+    // Unused trailing arguments are ignored by the format
+    const uint32_t *a = record->args;
+    snprintf(line, sizeof(line), record->fmt, a[0], a[1], a[2], a[3]);
+    ESP_LOG_LEVEL((esp_log_level_t)record->level, tag_names[record->tag], "(%lu) %s",
+        (unsigned long)record->time_ms, line);
+
+    atomic_store_explicit(&record->seq, tail + DLOG_RING_SIZE, memory_order_release);
+    tail++;
+    return true;
+}
+
+static void dlog_task(void *arg)
+{
+    while (true) {
+        while (dlog_drain_one()) {
+        }
+        unsigned lost = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+        if (lost) {
+            ESP_LOGW(TAG, "%u deferred records dropped", lost);
+        }
+        vTaskDelay(pdMS_TO_TICKS(DLOG_FLUSH_MS));
+    }
+}
+
+void dlog_init(void)
+{
+    static bool started = false;
+    TaskHandle_t task = NULL;
+
+    if (started) {
+        return;
+    }
+    started = true;
+    dlog_ring_reset();
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    task = xTaskCreateStatic(dlog_task, "dlog_task", DLOG_TASK_STACK, NULL,
+                    DLOG_TASK_PRIORITY, dlog_task_stack, &dlog_task_buffer);
+#else
+    xTaskCreate(dlog_task, "dlog_task", DLOG_TASK_STACK, NULL, DLOG_TASK_PRIORITY, &task);
+#endif
+    if (!task) {
+        ESP_LOGE(TAG, "Could not create deferred log task, logging directly");
+        memset(deferred, 0, sizeof(deferred));
+    }
+}
+
+bool dlog_is_deferred(dlog_tag_t tag)
+{
+    return tag < DLOG_TAG_MAX && deferred[tag];
+}
+
+void dlog_set_deferred(dlog_tag_t tag, bool on)
+{
+    if (tag < DLOG_TAG_MAX) {
+        deferred[tag] = on;
+    }
+}
+#else
+void dlog_init(void)
+{
+}
+
+bool dlog_is_deferred(dlog_tag_t tag)
+{
+    return false;
+}
+
+void dlog_set_deferred(dlog_tag_t tag, bool on)
+{
+    ESP_LOGW(TAG, "Deferred logging is not enabled (EXAMPLE_DLOG)");
+}
+
+void dlog_write(dlog_tag_t tag, esp_log_level_t level, const char *fmt, int argc, ...)
+{
+}
+#endif
+
+static int dlog_cmd(int argc, char **argv)
+{
+    if (argc == 3) {
+        for (int i = 0; i < DLOG_TAG_MAX; i++) {
+            if (strcmp(argv[1], tag_names[i]) == 0) {
+                dlog_set_deferred(i, strcmp(argv[2], "on") == 0);
+                return 0;
+            }
+        }
+    }
+    for (int i = 0; i < DLOG_TAG_MAX; i++) {
+        ESP_LOGI(TAG, "%-10s %s", tag_names[i], dlog_is_deferred(i) ? "deferred" : "direct");
+    }
+    return 0;
+}
+
+void dlog_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "dlog",
+        .help = "Show deferred logging per tag, or 'dlog <tag> on|off' to switch one",
+        .func = dlog_cmd,
+    };
+    esp_console_cmd_register(&cmd);
+}
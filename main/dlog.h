@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sdkconfig.h>
+#include <esp_log.h>
+
+// Tags that can defer their logging, see DLOGI()
+typedef enum {
+    DLOG_TAG_MAIN = 0,
+    DLOG_TAG_DEVICE,
+    DLOG_TAG_RAINMAKER,
+    DLOG_TAG_MAX,
+} dlog_tag_t;
+
+#ifdef CONFIG_EXAMPLE_DLOG
+// Records held until the drain task catches up, a power of two
+#define DLOG_RING_SIZE      64
+#define DLOG_MAX_ARGS       4
+#define DLOG_FLUSH_MS       200
+#define DLOG_TASK_STACK     3072
+#define DLOG_TASK_PRIORITY  1
+
+#define DLOG_ARGC_(_0, _1, _2, _3, _4, n, ...) n
+#define DLOG_ARGC(...) DLOG_ARGC_(_, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+
+/**
+ * @brief Log at info level, or for a deferred tag only record the format and arguments.
+ *
+ * Deferred arguments are copied as 32 bit words, so they must be integers or
+ * pointers to strings that outlive the record (literals, device names). The
+ * format pointer is the record ID, a host decoder can resolve it from the ELF.
+*/
+#define DLOGI(tag_id, tag, fmt, ...) do { \
+        _Static_assert(DLOG_ARGC(__VA_ARGS__) <= DLOG_MAX_ARGS, "Too many deferred log arguments"); \
+        if (dlog_is_deferred(tag_id)) { \
+            dlog_write(tag_id, ESP_LOG_INFO, fmt, DLOG_ARGC(__VA_ARGS__), ##__VA_ARGS__); \
+        } else { \
+            ESP_LOGI(tag, fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+#else
+#define DLOGI(tag_id, tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#endif
+
+/**
+ * @brief Start the drain task. Records written before this are kept.
+*/
+void dlog_init(void);
+
+bool dlog_is_deferred(dlog_tag_t tag);
+
+void dlog_set_deferred(dlog_tag_t tag, bool deferred);
+
+/**
+ * @brief Queue a record without formatting it, safe from any task.
+ * Drops the record (and counts it) when the ring is full.
+*/
+void dlog_write(dlog_tag_t tag, esp_log_level_t level, const char *fmt, int argc, ...);
+
+/**
+ * @brief Register the "dlog" console command.
+ * Call after esp_rmaker_console_init().
+*/
+void dlog_register_console(void);
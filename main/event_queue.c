@@ -0,0 +1,577 @@
+#include "event_queue.h"
+#include "registry.h"
+
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+
+enum {
+    LANE_COMMAND = 0,
+    LANE_TELEMETRY,
+    LANE_MAX,
+};
+
+// One latest-value slot per device and payload kind
+#define STATE_SLOT_COUNT (DEVICE_MAX * PAYLOAD_MAX)
+
+// Latest-value slots for coalesced state, pending slots are served oldest first
+typedef struct {
+    event_packet_t slots[STATE_SLOT_COUNT];
+    bool pending[STATE_SLOT_COUNT];
+    uint8_t order[STATE_SLOT_COUNT];
+    uint8_t head;
+    uint8_t count;
+} state_mailbox_t;
+
+typedef struct {
+    QueueHandle_t queue;
+    state_mailbox_t state;
+} event_lane_t;
+
+typedef struct {
+    const char *name;
+    event_policy_t policy;
+} producer_desc_t;
+
+// Name and policy of every producer, a macro so the pool size can be checked at build time
+#define PRODUCER_TABLE(X) \
+    X(PRODUCER_BUTTON,     "button",    EVENT_POLICY_COALESCE) \
+    X(PRODUCER_SENSOR,     "sensor",    EVENT_POLICY_OVERWRITE) \
+    X(PRODUCER_APP_LIGHT,  "app-light", EVENT_POLICY_COALESCE) \
+    X(PRODUCER_APP_PUMP,   "app-pump",  EVENT_POLICY_BLOCK) \
+    X(PRODUCER_CONTROLLER, "control",   EVENT_POLICY_COALESCE) \
+    X(PRODUCER_INPUT,      "input",     EVENT_POLICY_COALESCE)
+
+#define PRODUCER_ENTRY(id, name, policy) [id] = { name, policy },
+
+static const producer_desc_t producers[PRODUCER_MAX] = {
+    PRODUCER_TABLE(PRODUCER_ENTRY)
+};
+
+static event_lane_t lanes[LANE_MAX];
+static event_producer_stats_t stats[PRODUCER_MAX];
+static portMUX_TYPE event_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t consumer_task = NULL;
+
+static event_latency_t latency[DEVICE_TYPE_MAX][LATENCY_STAGE_MAX];
+static uint32_t depth_samples[LANE_MAX][DEPTH_BUCKETS];
+
+static const char *type_names[DEVICE_TYPE_MAX] = {
+    [DEVICE_LED] = "led",
+    [DEVICE_PUMP] = "pump",
+    [DEVICE_SENSOR] = "sensor",
+};
+static const char *lane_names[LANE_MAX] = {
+    [LANE_COMMAND] = "command",
+    [LANE_TELEMETRY] = "telemetry",
+};
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+static StaticQueue_t queue_buffers[LANE_MAX];
+#endif
+
+static const char *TAG = "EVENT";
+
+/******************************************************
+ * Queue items, a pool handle or a full packet copy
+******************************************************/
+
+#ifdef CONFIG_EXAMPLE_EVENT_POOL
+_Static_assert(EVENT_POOL_SIZE <= UINT8_MAX, "Pool handles are one byte");
+
+// Each queuing producer needs its own spare packet, see EVENT_POOL_SIZE
+#define PRODUCER_QUEUES(id, name, policy) + ((policy) != EVENT_POLICY_COALESCE)
+_Static_assert(0 PRODUCER_TABLE(PRODUCER_QUEUES) <= EVENT_QUEUED_PRODUCERS,
+               "More producers queue packets than the pool has spares for, raise EVENT_QUEUED_PRODUCERS");
+
+typedef uint8_t lane_item_t;
+
+static event_packet_t pool[EVENT_POOL_SIZE];
+static uint8_t pool_free[EVENT_POOL_SIZE];
+static uint8_t pool_free_count;
+
+static void pool_init(void)
+{
+    for (int i = 0; i < EVENT_POOL_SIZE; i++) {
+        pool_free[i] = i;
+    }
+    pool_free_count = EVENT_POOL_SIZE;
+}
+
+static bool item_make(lane_item_t *item, const event_packet_t *event)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&event_lock);
+    if (pool_free_count > 0) {
+        *item = pool_free[--pool_free_count];
+        found = true;
+    }
+    portEXIT_CRITICAL(&event_lock);
+
+    if (found) {
+        pool[*item] = *event;
+    }
+    return found;
+}
+
+static void item_discard(const lane_item_t *item)
+{
+    portENTER_CRITICAL(&event_lock);
+    pool_free[pool_free_count++] = *item;
+    portEXIT_CRITICAL(&event_lock);
+}
+
+static const event_packet_t *item_packet(const lane_item_t *item)
+{
+    return &pool[*item];
+}
+#else
+typedef event_packet_t lane_item_t;
+
+static void pool_init(void)
+{
+}
+
+static bool item_make(lane_item_t *item, const event_packet_t *event)
+{
+    *item = *event;
+    return true;
+}
+
+static void item_discard(const lane_item_t *item)
+{
+}
+
+static const event_packet_t *item_packet(const lane_item_t *item)
+{
+    return item;
+}
+#endif
+
+void event_queue_init(void)
+{
+    pool_init();
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    static uint8_t command_storage[COMMAND_QUEUE_LEN * sizeof(lane_item_t)];
+    static uint8_t telemetry_storage[TELEMETRY_QUEUE_LEN * sizeof(lane_item_t)];
+
+    lanes[LANE_COMMAND].queue = xQueueCreateStatic(COMMAND_QUEUE_LEN, sizeof(lane_item_t),
+                                    command_storage, &queue_buffers[LANE_COMMAND]);
+    lanes[LANE_TELEMETRY].queue = xQueueCreateStatic(TELEMETRY_QUEUE_LEN, sizeof(lane_item_t),
+                                    telemetry_storage, &queue_buffers[LANE_TELEMETRY]);
+#else
+    lanes[LANE_COMMAND].queue = xQueueCreate(COMMAND_QUEUE_LEN, sizeof(lane_item_t));
+    lanes[LANE_TELEMETRY].queue = xQueueCreate(TELEMETRY_QUEUE_LEN, sizeof(lane_item_t));
+#endif
+
+    if (!lanes[LANE_COMMAND].queue || !lanes[LANE_TELEMETRY].queue) {
+        ESP_LOGE(TAG, "Could not create event queues");
+        return;
+    }
+    consumer_task = xTaskGetCurrentTaskHandle();
+}
+
+/******************************************************
+ * Producer side
+******************************************************/
+
+static bool mailbox_put(state_mailbox_t *mailbox, const event_packet_t *event, bool *replaced)
+{
+    if (event->device >= DEVICE_MAX || event->payload >= PAYLOAD_MAX) {
+        return false;
+    }
+    uint8_t slot = event->device * PAYLOAD_MAX + event->payload;
+
+    portENTER_CRITICAL(&event_lock);
+    mailbox->slots[slot] = *event;
+    *replaced = mailbox->pending[slot];
+    if (!*replaced) {
+        mailbox->pending[slot] = true;
+        mailbox->order[(mailbox->head + mailbox->count) % STATE_SLOT_COUNT] = slot;
+        mailbox->count++;
+    }
+    portEXIT_CRITICAL(&event_lock);
+    return true;
+}
+
+static bool queue_put(QueueHandle_t queue, const event_packet_t *event, event_policy_t policy,
+                      bool *overwrote, bool *pool_empty)
+{
+    lane_item_t item;
+
+    *overwrote = false;
+    *pool_empty = !item_make(&item, event);
+    if (*pool_empty) {
+        return false;
+    }
+
+    if (policy == EVENT_POLICY_BLOCK) {
+        if (xQueueSend(queue, &item, pdMS_TO_TICKS(COMMAND_SEND_TIMEOUT_MS)) == pdTRUE) {
+            return true;
+        }
+    } else if (xQueueSend(queue, &item, 0) == pdTRUE) {
+        return true;
+    } else {
+        // Lane is full, make room by discarding the oldest event
+        lane_item_t oldest;
+        if (xQueueReceive(queue, &oldest, 0) == pdTRUE) {
+            item_discard(&oldest);
+            *overwrote = true;
+        }
+        if (xQueueSend(queue, &item, 0) == pdTRUE) {
+            return true;
+        }
+    }
+
+    item_discard(&item);
+    return false;
+}
+
+bool event_send(const event_packet_t *event, event_producer_t producer)
+{
+    event_lane_t *lane = &lanes[(event->direction == APP_TO_ESP) ? LANE_COMMAND : LANE_TELEMETRY];
+
+    if (producer >= PRODUCER_MAX || !lane->queue) {
+        return false;
+    }
+
+    bool accepted;
+    bool replaced = false;
+    bool overwrote = false;
+    bool pool_empty = false;
+    event_packet_t stamped = *event;
+
+    // Coalesced values keep the time of the latest update
+    stamped.enqueued_us = (uint32_t)esp_timer_get_time();
+    if (producers[producer].policy == EVENT_POLICY_COALESCE) {
+        accepted = mailbox_put(&lane->state, &stamped, &replaced);
+    } else {
+        accepted = queue_put(lane->queue, &stamped, producers[producer].policy, &overwrote, &pool_empty);
+    }
+
+    uint32_t depth = uxQueueMessagesWaiting(lane->queue) + lane->state.count;
+
+    portENTER_CRITICAL(&event_lock);
+    event_producer_stats_t *s = &stats[producer];
+    if (accepted) {
+        s->enqueued++;
+        s->coalesced += replaced;
+        s->overwritten += overwrote;
+        if (depth > s->high_water) {
+            s->high_water = depth;
+        }
+    } else if (pool_empty) {
+        s->pool_empty++;
+    } else {
+        s->dropped++;
+    }
+    portEXIT_CRITICAL(&event_lock);
+
+    if (!accepted) {
+        return false;
+    }
+
+    // Wake the consumer, the notification count covers events posted before it sleeps
+    if (consumer_task) {
+        xTaskNotifyGive(consumer_task);
+    }
+    return true;
+}
+
+/******************************************************
+ * Consumer side
+******************************************************/
+
+// Only one consumer task exists, so the packet it holds can live here
+static lane_item_t current_item;
+static event_packet_t current_state;
+static uint32_t current_dequeued_us;
+
+static uint8_t log2_bucket(uint32_t value, uint8_t buckets)
+{
+    uint8_t bucket = 0;
+
+    while (value && bucket < buckets - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static uint8_t event_type(const event_packet_t *event)
+{
+    device_desc_t *dev = registry_get(event->device);
+    return dev ? dev->type : DEVICE_TYPE_MAX;
+}
+
+static void latency_record(const event_packet_t *event, event_latency_stage_t stage, uint32_t us)
+{
+    uint8_t type = event_type(event);
+
+    if (type >= DEVICE_TYPE_MAX) {
+        return;
+    }
+    portENTER_CRITICAL(&event_lock);
+    event_latency_t *l = &latency[type][stage];
+    l->count++;
+    l->total_us += us;
+    if (us > l->max_us) {
+        l->max_us = us;
+    }
+    l->buckets[log2_bucket(us, LATENCY_BUCKETS)]++;
+    portEXIT_CRITICAL(&event_lock);
+}
+
+/**
+ * @brief Sample how deep each lane is when the consumer comes to take an event.
+*/
+static void depth_record(void)
+{
+    for (int i = 0; i < LANE_MAX; i++) {
+        uint32_t depth = uxQueueMessagesWaiting(lanes[i].queue) + lanes[i].state.count;
+        portENTER_CRITICAL(&event_lock);
+        depth_samples[i][log2_bucket(depth, DEPTH_BUCKETS)]++;
+        portEXIT_CRITICAL(&event_lock);
+    }
+}
+
+static bool mailbox_take(state_mailbox_t *mailbox, event_packet_t *event)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&event_lock);
+    if (mailbox->count > 0) {
+        uint8_t slot = mailbox->order[mailbox->head];
+        *event = mailbox->slots[slot];
+        mailbox->pending[slot] = false;
+        mailbox->head = (mailbox->head + 1) % STATE_SLOT_COUNT;
+        mailbox->count--;
+        found = true;
+    }
+    portEXIT_CRITICAL(&event_lock);
+    return found;
+}
+
+/**
+ * @brief Send time of the value mailbox_take() would return next.
+*/
+static bool mailbox_head_us(state_mailbox_t *mailbox, uint32_t *us)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&event_lock);
+    if (mailbox->count > 0) {
+        *us = mailbox->slots[mailbox->order[mailbox->head]].enqueued_us;
+        found = true;
+    }
+    portEXIT_CRITICAL(&event_lock);
+    return found;
+}
+
+/**
+ * @brief Take the older of the lane's queue head and mailbox head, so a queued
+ * and a coalesced command for the same device apply in the order they were sent.
+*/
+static const event_packet_t *lane_take(event_lane_t *lane)
+{
+    lane_item_t head;
+    uint32_t state_us;
+    bool queued = (xQueuePeek(lane->queue, &head, 0) == pdTRUE);
+    bool state = mailbox_head_us(&lane->state, &state_us);
+
+    // A coalesced value counts from its latest update, wraparound safe
+    if (queued && (!state || (int32_t)(item_packet(&head)->enqueued_us - state_us) <= 0)) {
+        if (xQueueReceive(lane->queue, &current_item, 0) == pdTRUE) {
+            return item_packet(&current_item);
+        }
+    }
+    if (mailbox_take(&lane->state, &current_state)) {
+        return &current_state;
+    }
+    return NULL;
+}
+
+static const event_packet_t *event_try_receive(void)
+{
+    const event_packet_t *event = NULL;
+
+    depth_record();
+    for (int i = 0; i < LANE_MAX && !event; i++) {
+        event = lane_take(&lanes[i]);
+    }
+
+    if (event) {
+        current_dequeued_us = (uint32_t)esp_timer_get_time();
+        latency_record(event, LATENCY_QUEUED, current_dequeued_us - event->enqueued_us);
+    }
+    return event;
+}
+
+const event_packet_t *event_receive(TickType_t wait)
+{
+    while (true) {
+        const event_packet_t *event = event_try_receive();
+        if (event) {
+            return event;
+        }
+        if (wait == 0 || ulTaskNotifyTake(pdTRUE, wait) == 0) {
+            return NULL;
+        }
+        // Woken without an event, see event_queue_wake()
+        wait = 0;
+    }
+}
+
+void event_queue_wake(void)
+{
+    if (consumer_task) {
+        xTaskNotifyGive(consumer_task);
+    }
+}
+
+void event_release(const event_packet_t *event)
+{
+    if (!event) {
+        return;
+    }
+    latency_record(event, LATENCY_SERVICE, (uint32_t)esp_timer_get_time() - current_dequeued_us);
+    if (event != &current_state) {
+        item_discard(&current_item);
+    }
+}
+
+/******************************************************
+ * Statistics
+******************************************************/
+
+void event_queue_get_stats(event_producer_t producer, event_producer_stats_t *out)
+{
+    if (producer >= PRODUCER_MAX) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    portENTER_CRITICAL(&event_lock);
+    *out = stats[producer];
+    portEXIT_CRITICAL(&event_lock);
+}
+
+void event_queue_log_stats(void)
+{
+    ESP_LOGI(TAG, "%-10s %8s %8s %8s %8s %8s %5s", "producer", "enqueued", "dropped", "pool", "overwr", "coalesc", "hwm");
+    for (int i = 0; i < PRODUCER_MAX; i++) {
+        event_producer_stats_t s;
+        event_queue_get_stats(i, &s);
+        ESP_LOGI(TAG, "%-10s %8lu %8lu %8lu %8lu %8lu %5lu", producers[i].name,
+            (unsigned long)s.enqueued, (unsigned long)s.dropped, (unsigned long)s.pool_empty,
+            (unsigned long)s.overwritten, (unsigned long)s.coalesced, (unsigned long)s.high_water);
+    }
+    ESP_LOGI(TAG, "Lane sizes: command %d, telemetry %d, item %u bytes",
+        COMMAND_QUEUE_LEN, TELEMETRY_QUEUE_LEN, (unsigned)sizeof(lane_item_t));
+#ifdef CONFIG_EXAMPLE_EVENT_POOL
+    ESP_LOGI(TAG, "Pool: %d packets", EVENT_POOL_SIZE);
+#endif
+}
+
+void event_queue_get_latency(uint8_t type, event_latency_stage_t stage, event_latency_t *out)
+{
+    if (type >= DEVICE_TYPE_MAX || stage >= LATENCY_STAGE_MAX) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    portENTER_CRITICAL(&event_lock);
+    *out = latency[type][stage];
+    portEXIT_CRITICAL(&event_lock);
+}
+
+void event_queue_reset_latency(void)
+{
+    portENTER_CRITICAL(&event_lock);
+    memset(latency, 0, sizeof(latency));
+    memset(depth_samples, 0, sizeof(depth_samples));
+    portEXIT_CRITICAL(&event_lock);
+}
+
+/**
+ * @brief Upper bound of the bucket holding the given percentile, in microseconds.
+*/
+static uint32_t latency_percentile(const event_latency_t *l, uint32_t percent)
+{
+    uint32_t target = (l->count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        seen += l->buckets[i];
+        if (seen >= target) {
+            return (1u << i) > l->max_us ? l->max_us : (1u << i);
+        }
+    }
+    return l->max_us;
+}
+
+void event_queue_log_latency(void)
+{
+    static const char *stage_names[LATENCY_STAGE_MAX] = { "queued", "service" };
+
+    ESP_LOGI(TAG, "%-7s %-8s %7s %8s %8s %8s %8s %9s", "type", "stage", "count", "mean", "p50", "p90", "p99", "max (us)");
+    for (int type = 0; type < DEVICE_TYPE_MAX; type++) {
+        for (int stage = 0; stage < LATENCY_STAGE_MAX; stage++) {
+            event_latency_t l;
+            event_queue_get_latency(type, stage, &l);
+            if (l.count == 0) {
+                continue;
+            }
+            ESP_LOGI(TAG, "%-7s %-8s %7lu %8lu %8lu %8lu %8lu %9lu", type_names[type], stage_names[stage],
+                (unsigned long)l.count, (unsigned long)(l.total_us / l.count),
+                (unsigned long)latency_percentile(&l, 50), (unsigned long)latency_percentile(&l, 90),
+                (unsigned long)latency_percentile(&l, 99), (unsigned long)l.max_us);
+        }
+    }
+
+    // Depth buckets: 0, 1, 2-3, 4-7, ...
+    _Static_assert(DEPTH_BUCKETS == 8, "Update the depth log format");
+    for (int i = 0; i < LANE_MAX; i++) {
+        uint32_t d[DEPTH_BUCKETS];
+        portENTER_CRITICAL(&event_lock);
+        memcpy(d, depth_samples[i], sizeof(d));
+        portEXIT_CRITICAL(&event_lock);
+        ESP_LOGI(TAG, "%-9s depth 0:%lu 1:%lu 2+:%lu 4+:%lu 8+:%lu 16+:%lu 32+:%lu 64+:%lu", lane_names[i],
+            (unsigned long)d[0], (unsigned long)d[1], (unsigned long)d[2], (unsigned long)d[3],
+            (unsigned long)d[4], (unsigned long)d[5], (unsigned long)d[6], (unsigned long)d[7]);
+    }
+}
+
+static int event_stats_cmd(int argc, char **argv)
+{
+    event_queue_log_stats();
+    return 0;
+}
+
+static int event_latency_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        event_queue_reset_latency();
+        return 0;
+    }
+    event_queue_log_latency();
+    return 0;
+}
+
+void event_queue_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "event-stats",
+        .help = "Per-producer enqueue/drop/high-water counters of the event lanes",
+        .func = event_stats_cmd,
+    };
+    esp_console_cmd_register(&cmd);
+
+    const esp_console_cmd_t latency_cmd = {
+        .command = "event-latency",
+        .help = "Queue and service latency per device type and lane depth samples, 'reset' clears them",
+        .func = event_latency_cmd,
+    };
+    esp_console_cmd_register(&latency_cmd);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include "packet.h"
+
+// Lane sizes, commands are rare but must never wait behind telemetry
+#define COMMAND_QUEUE_LEN   10
+#define TELEMETRY_QUEUE_LEN 40
+
+#ifdef CONFIG_EXAMPLE_EVENT_POOL
+// Producers whose policy queues packets (BLOCK or OVERWRITE), checked against the table at build time
+#define EVENT_QUEUED_PRODUCERS 2
+// One packet per queue slot, one held by the consumer, and one per queuing producer:
+// a blocked send holds its packet while it waits, an overwrite while the oldest is discarded
+#define EVENT_POOL_SIZE (COMMAND_QUEUE_LEN + TELEMETRY_QUEUE_LEN + 1 + EVENT_QUEUED_PRODUCERS)
+#endif
+
+// How long a blocking producer may wait for room in its lane
+#define COMMAND_SEND_TIMEOUT_MS 100
+
+// Event sources, each has its own backpressure policy and counters
+typedef enum {
+    PRODUCER_BUTTON = 0,
+    PRODUCER_SENSOR,
+    PRODUCER_APP_LIGHT,
+    PRODUCER_APP_PUMP,
+    PRODUCER_CONTROLLER,
+    PRODUCER_INPUT,
+    PRODUCER_MAX,
+} event_producer_t;
+
+// What happens when a producer's lane is full
+typedef enum {
+    EVENT_POLICY_BLOCK = 0,  // Wait up to COMMAND_SEND_TIMEOUT_MS, then drop
+    EVENT_POLICY_OVERWRITE,  // Discard the oldest queued event
+    EVENT_POLICY_COALESCE,   // Keep only the latest value per device, never queued
+} event_policy_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t dropped;
+    uint32_t pool_empty;    // Not sent for lack of a free pool packet, not counted in dropped
+    uint32_t overwritten;   // Older events discarded to make room
+    uint32_t coalesced;     // Pending values replaced by a newer one
+    uint32_t high_water;    // Deepest lane depth seen right after an enqueue
+} event_producer_stats_t;
+
+// Latency histograms, bucket i counts latencies below 2^i microseconds
+// that did not fit bucket i - 1, the last bucket is open ended
+#define LATENCY_BUCKETS 22
+
+// Lane depth seen by the consumer, bucket i holds depths below 2^i
+#define DEPTH_BUCKETS   8
+
+typedef enum {
+    LATENCY_QUEUED = 0,     // event_send() to event_receive()
+    LATENCY_SERVICE,        // event_receive() to event_release()
+    LATENCY_STAGE_MAX,
+} event_latency_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} event_latency_t;
+
+/**
+ * @brief Create the command and telemetry lanes.
+ *
+ * Must be called from the task that consumes events with event_receive(),
+ * producers wake that task directly through its notification value.
+*/
+void event_queue_init(void);
+
+/**
+ * @brief Post an event on its lane, applying the producer's backpressure policy.
+ * APP_TO_ESP events go to the command lane and everything else to the telemetry lane.
+ *
+ * @return true if the event was accepted
+*/
+bool event_send(const event_packet_t *event, event_producer_t producer);
+
+/**
+ * @brief Fetch the next event, commands always take priority over telemetry.
+ *
+ * Within a lane, queued and coalesced events come out in the order they were
+ * sent, a coalesced value taking the time of its latest update.
+ *
+ * Only blocks (up to `wait` ticks) when both lanes are empty. The returned
+ * packet stays valid until it is handed back with event_release(), in pool
+ * mode it points straight into the packet pool.
+ *
+ * @return the next event, or NULL on timeout or event_queue_wake()
+*/
+const event_packet_t *event_receive(TickType_t wait);
+
+/**
+ * @brief Make a blocked event_receive() return early so the consumer can do other work.
+*/
+void event_queue_wake(void);
+
+void event_release(const event_packet_t *event);
+
+void event_queue_get_stats(event_producer_t producer, event_producer_stats_t *stats);
+
+void event_queue_log_stats(void);
+
+/**
+ * @brief Latency histogram of one pipeline stage for events of a device type (DEVICE_*).
+*/
+void event_queue_get_latency(uint8_t type, event_latency_stage_t stage, event_latency_t *latency);
+
+void event_queue_log_latency(void);
+
+void event_queue_reset_latency(void);
+
+/**
+ * @brief Register the "event-stats" and "event-latency" console commands.
+ * Call after esp_rmaker_console_init().
+*/
+void event_queue_register_console(void);
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#include "packet.h"
+
+/**
+ * Thin layer between the device and reporting code and the board/cloud SDKs.
+ * hal_esp.c implements it on ESP-IDF and RainMaker. device.c, status_led.c and
+ * rainMaker.c reach the hardware, NVS, Wi-Fi and the cloud only through it, so
+ * another port (host/fakes/hal_host.c) runs them unchanged.
+*/
+
+/******************************************************
+ * GPIO
+******************************************************/
+
+esp_err_t hal_gpio_output(int gpio, bool pull_up);
+
+void hal_gpio_write(int gpio, bool level);
+
+/**
+ * @brief Latch (or release) a pad at its current level.
+*/
+void hal_gpio_hold(int gpio, bool hold);
+
+/**
+ * @brief Keep latched pads latched through deep sleep.
+*/
+void hal_gpio_hold_in_sleep(void);
+
+typedef void (*hal_gpio_isr_t)(void *arg);
+
+/**
+ * @brief Configure an input that calls `isr` from interrupt context on every edge.
+*/
+esp_err_t hal_gpio_input(int gpio, bool pull_up, hal_gpio_isr_t isr, void *arg);
+
+/**
+ * @brief Current pad level, safe to call from an edge ISR.
+*/
+bool hal_gpio_read(int gpio);
+
+/******************************************************
+ * Pulse counter
+******************************************************/
+
+typedef void *hal_counter_t;
+
+/**
+ * @brief Count rising edges on `gpio` in hardware, glitches shorter than a microsecond are ignored.
+*/
+esp_err_t hal_counter_init(int gpio, hal_counter_t *counter);
+
+/**
+ * @brief Edges counted since hal_counter_init(), extended past the hardware counter's range.
+*/
+int32_t hal_counter_read(hal_counter_t counter);
+
+/******************************************************
+ * PWM
+******************************************************/
+
+// Duty cycles are given in permille of full scale
+#define HAL_PWM_DUTY_MAX 1000
+
+/**
+ * @brief Drive `gpio` from PWM channel `channel`, starting at zero duty.
+ *
+ * @param invert true when the load is on while the pad is low
+*/
+esp_err_t hal_pwm_init(uint8_t channel, int gpio, uint32_t freq_hz, bool invert);
+
+/**
+ * @brief Ramp a channel to a new duty in hardware and return at once.
+ * A fade still running is cut short and the new one starts from where it got to.
+*/
+esp_err_t hal_pwm_fade(uint8_t channel, uint16_t permille, uint32_t ramp_ms);
+
+/**
+ * @brief Stop a channel with its load off right away, e.g. before the pad is latched for deep sleep.
+*/
+void hal_pwm_stop(uint8_t channel);
+
+/******************************************************
+ * Status LED
+******************************************************/
+
+esp_err_t hal_led_init(void);
+
+/**
+ * @brief Show a colour, all zero turns the LED off.
+*/
+void hal_led_write(uint8_t red, uint8_t green, uint8_t blue);
+
+/******************************************************
+ * Storage and network
+******************************************************/
+
+/**
+ * @brief Bring up the default NVS partition, erasing it if its layout is stale.
+*/
+esp_err_t hal_storage_init(void);
+
+/**
+ * @brief Set up Wi-Fi, call before hal_cloud_init().
+*/
+esp_err_t hal_wifi_init(void);
+
+/**
+ * @brief Connect, or start provisioning if the node has no credentials yet.
+ * Returns once connected.
+*/
+esp_err_t hal_wifi_start(void);
+
+/******************************************************
+ * Cloud node
+******************************************************/
+
+// Standard cloud devices and the params each comes with
+typedef enum {
+    HAL_CLOUD_LIGHT = 0,    // Power (PAYLOAD_ON_OFF) and brightness (PAYLOAD_LEVEL)
+    HAL_CLOUD_FAN,          // Power (PAYLOAD_ON_OFF) and speed (PAYLOAD_LEVEL)
+    HAL_CLOUD_SENSOR,       // Reading (PAYLOAD_READING), shown as a temperature for now
+    HAL_CLOUD_PLAIN,        // No params
+} hal_cloud_kind_t;
+
+typedef struct {
+    hal_cloud_kind_t kind;
+    const char *name;
+    const char *level_name;     // Name of the PAYLOAD_LEVEL param
+    void *priv;                 // Handed back with every write to the device
+    // Initial param values
+    bool on_off;
+    int32_t level;
+    float reading;
+} hal_cloud_device_t;
+
+/**
+ * @brief A param written from the app or a schedule, booleans arrive as 0 or 1.
+ *
+ * @param source who wrote it, for logging, NULL if not known
+*/
+typedef esp_err_t (*hal_cloud_write_t)(void *priv, void *param, int32_t value, const char *source);
+
+typedef void (*hal_cloud_connection_t)(bool connected);
+
+/**
+ * @brief Start the cloud agent's console and create the node.
+ * Call after hal_wifi_init() and before hal_wifi_start().
+ *
+ * @param write called for every param write, from the agent's task
+ * @param connection called when the MQTT connection comes up or drops
+*/
+esp_err_t hal_cloud_init(const char *name, const char *type, hal_cloud_write_t write,
+                         hal_cloud_connection_t connection);
+
+/**
+ * @brief Create a device with the params of its kind.
+ *
+ * @param[out] params handle of each param by payload kind, NULL where the kind has none
+ * @return the device, opaque here, or NULL on failure
+*/
+void *hal_cloud_device_create(const hal_cloud_device_t *device, void *params[PAYLOAD_MAX]);
+
+esp_err_t hal_cloud_device_add_attribute(void *device, const char *name, const char *value);
+
+esp_err_t hal_cloud_node_add_device(void *device);
+
+/**
+ * @brief Enable the timezone, schedule and scene services and start the agent.
+*/
+esp_err_t hal_cloud_start(void);
+
+const char *hal_cloud_node_id(void);
+
+/******************************************************
+ * Cloud sink
+******************************************************/
+
+/**
+ * @brief Update the cloud's local copy of a param without sending it.
+ *
+ * @param param the handle the cloud SDK gave out for this param, opaque here
+*/
+esp_err_t hal_cloud_stage(void *param, const event_packet_t *event);
+
+/**
+ * @brief Send every staged param in one report.
+*/
+esp_err_t hal_cloud_report(void);
+
+esp_err_t hal_cloud_publish(const char *topic, const char *data, size_t len);
+
+/**
+ * @brief Forget the Wi-Fi credentials, or every setting for a factory reset, then reboot.
+*/
+esp_err_t hal_cloud_reset(bool factory);
@@ -0,0 +1,493 @@
+#include "hal.h"
+
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <driver/pulse_cnt.h>
+#include <esp_pm.h>
+#include <esp_attr.h>
+#include <ws2812_led.h>
+#include <nvs_flash.h>
+#include <app_wifi.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_mqtt.h>
+#include <esp_rmaker_utils.h>
+#include <esp_rmaker_standard_params.h>
+#include <esp_rmaker_standard_devices.h>
+#include <esp_rmaker_standard_types.h>
+#include <esp_rmaker_schedule.h>
+#include <esp_rmaker_scenes.h>
+#include <esp_rmaker_console.h>
+#include <esp_rmaker_common_events.h>
+
+/******************************************************
+ * GPIO
+******************************************************/
+
+esp_err_t hal_gpio_output(int gpio, bool pull_up)
+{
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = pull_up ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pin_bit_mask = ((uint64_t)1 << gpio),
+    };
+    return gpio_config(&io_conf);
+}
+
+void hal_gpio_write(int gpio, bool level)
+{
+    gpio_set_level(gpio, level);
+}
+
+void hal_gpio_hold(int gpio, bool hold)
+{
+    if (hold) {
+        gpio_hold_en(gpio);
+    } else {
+        gpio_hold_dis(gpio);
+    }
+}
+
+void hal_gpio_hold_in_sleep(void)
+{
+    gpio_deep_sleep_hold_en();
+}
+
+esp_err_t hal_gpio_input(int gpio, bool pull_up, hal_gpio_isr_t isr, void *arg)
+{
+    static bool isr_service = false;
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_ANYEDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = pull_up ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pin_bit_mask = ((uint64_t)1 << gpio),
+    };
+    esp_err_t err = gpio_config(&io_conf);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!isr_service) {
+        // Per pin handlers, someone else may have installed the service already
+        err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            return err;
+        }
+        isr_service = true;
+    }
+    return gpio_isr_handler_add(gpio, isr, arg);
+}
+
+bool hal_gpio_read(int gpio)
+{
+    return gpio_get_level(gpio);
+}
+
+/******************************************************
+ * Pulse counter
+******************************************************/
+
+// Hardware range of a unit, the driver folds overflows into the count
+#define HAL_COUNTER_LIMIT 32767
+
+esp_err_t hal_counter_init(int gpio, hal_counter_t *counter)
+{
+    pcnt_unit_config_t unit_conf = {
+        .low_limit = -HAL_COUNTER_LIMIT,
+        .high_limit = HAL_COUNTER_LIMIT,
+        .flags.accum_count = true,
+    };
+    pcnt_chan_config_t chan_conf = {
+        .edge_gpio_num = gpio,
+        .level_gpio_num = -1,
+    };
+    pcnt_glitch_filter_config_t filter_conf = {
+        .max_glitch_ns = 1000,
+    };
+    pcnt_unit_handle_t unit = NULL;
+    pcnt_channel_handle_t chan = NULL;
+
+    esp_err_t err = pcnt_new_unit(&unit_conf, &unit);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = pcnt_unit_set_glitch_filter(unit, &filter_conf);
+    if (err == ESP_OK) {
+        err = pcnt_new_channel(unit, &chan_conf, &chan);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_channel_set_edge_action(chan, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD);
+    }
+    if (err == ESP_OK) {
+        // Accumulation only happens at a watch point, put one at the limit
+        err = pcnt_unit_add_watch_point(unit, HAL_COUNTER_LIMIT);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_unit_enable(unit);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_unit_clear_count(unit);
+    }
+    if (err == ESP_OK) {
+        err = pcnt_unit_start(unit);
+    }
+    if (err != ESP_OK) {
+        // Hand the unit back so a missing flow meter costs nothing else
+        pcnt_unit_disable(unit);
+        if (chan) {
+            pcnt_del_channel(chan);
+        }
+        pcnt_del_unit(unit);
+        return err;
+    }
+
+    *counter = unit;
+    return ESP_OK;
+}
+
+int32_t hal_counter_read(hal_counter_t counter)
+{
+    int count = 0;
+
+    pcnt_unit_get_count((pcnt_unit_handle_t)counter, &count);
+    return count;
+}
+
+/******************************************************
+ * PWM
+******************************************************/
+
+// All channels share one timer, 10 bits still allow fades of a thousand steps
+#define HAL_PWM_MODE        LEDC_LOW_SPEED_MODE
+#define HAL_PWM_TIMER       LEDC_TIMER_0
+#define HAL_PWM_RESOLUTION  LEDC_TIMER_10_BIT
+// A duty of 2^bits keeps the output on for the whole period
+#define HAL_PWM_FULL_SCALE  (1 << 10)
+
+#ifdef CONFIG_PM_ENABLE
+// The timer runs from APB, which drops with DFS and stops in light sleep.
+// Held while any channel may be driving its load
+static esp_pm_lock_handle_t pwm_pm_lock;
+static portMUX_TYPE pwm_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t pwm_running;        // Bit per channel whose output is not off
+
+static IRAM_ATTR void pwm_set_running(uint8_t channel, bool running)
+{
+    portENTER_CRITICAL_SAFE(&pwm_lock);
+    uint32_t before = pwm_running;
+    pwm_running = running ? (pwm_running | (1U << channel)) : (pwm_running & ~(1U << channel));
+    bool acquire = !before && pwm_running;
+    bool release = before && !pwm_running;
+    portEXIT_CRITICAL_SAFE(&pwm_lock);
+
+    if (acquire) {
+        esp_pm_lock_acquire(pwm_pm_lock);
+    } else if (release) {
+        esp_pm_lock_release(pwm_pm_lock);
+    }
+}
+
+// Fade end interrupt, a ramp down only lets the clock go once it has reached zero
+static IRAM_ATTR bool pwm_fade_end(const ledc_cb_param_t *param, void *arg)
+{
+    if (param->event == LEDC_FADE_END_EVT && param->duty == 0) {
+        pwm_set_running(param->channel, false);
+    }
+    return false;
+}
+#else
+static void pwm_set_running(uint8_t channel, bool running)
+{
+}
+#endif
+
+esp_err_t hal_pwm_init(uint8_t channel, int gpio, uint32_t freq_hz, bool invert)
+{
+    static bool timer_ready = false;
+    esp_err_t err;
+
+    if (channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!timer_ready) {
+        ledc_timer_config_t timer_conf = {
+            .speed_mode = HAL_PWM_MODE,
+            .duty_resolution = HAL_PWM_RESOLUTION,
+            .timer_num = HAL_PWM_TIMER,
+            .freq_hz = freq_hz,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+        err = ledc_timer_config(&timer_conf);
+        if (err != ESP_OK) {
+            return err;
+        }
+        // Fades step in hardware, the driver only takes an interrupt when one ends
+        err = ledc_fade_func_install(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            return err;
+        }
+#ifdef CONFIG_PM_ENABLE
+        err = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "pump_pwm", &pwm_pm_lock);
+        if (err != ESP_OK) {
+            return err;
+        }
+#endif
+        timer_ready = true;
+    }
+
+    ledc_channel_config_t channel_conf = {
+        .gpio_num = gpio,
+        .speed_mode = HAL_PWM_MODE,
+        .channel = channel,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = HAL_PWM_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+        .flags.output_invert = invert,
+    };
+    esp_err_t err_channel = ledc_channel_config(&channel_conf);
+#ifdef CONFIG_PM_ENABLE
+    if (err_channel == ESP_OK) {
+        ledc_cbs_t callbacks = {
+            .fade_cb = pwm_fade_end,
+        };
+        err_channel = ledc_cb_register(HAL_PWM_MODE, channel, &callbacks, NULL);
+    }
+#endif
+    return err_channel;
+}
+
+esp_err_t hal_pwm_fade(uint8_t channel, uint16_t permille, uint32_t ramp_ms)
+{
+    uint32_t duty = (uint32_t)((permille > HAL_PWM_DUTY_MAX) ? HAL_PWM_DUTY_MAX : permille)
+                    * HAL_PWM_FULL_SCALE / HAL_PWM_DUTY_MAX;
+
+    // Otherwise the new fade would block until the running one has ended
+    ledc_fade_stop(HAL_PWM_MODE, channel);
+    if (!duty && ledc_get_duty(HAL_PWM_MODE, channel) == 0) {
+        // Already off, an empty fade might never report its end
+        ramp_ms = 0;
+    }
+    if (duty) {
+        pwm_set_running(channel, true);
+    }
+    if (ramp_ms == 0) {
+        esp_err_t err = ledc_set_duty(HAL_PWM_MODE, channel, duty);
+        if (err == ESP_OK) {
+            err = ledc_update_duty(HAL_PWM_MODE, channel);
+        }
+        if (!duty) {
+            pwm_set_running(channel, false);
+        }
+        return err;
+    }
+    // Stopping ramps release the clock from the fade end interrupt
+    return ledc_set_fade_time_and_start(HAL_PWM_MODE, channel, duty, ramp_ms, LEDC_FADE_NO_WAIT);
+}
+
+void hal_pwm_stop(uint8_t channel)
+{
+    if (channel >= LEDC_CHANNEL_MAX) {
+        return;
+    }
+    ledc_fade_stop(HAL_PWM_MODE, channel);
+    // The idle level goes through the output inversion too, low always means load off
+    ledc_stop(HAL_PWM_MODE, channel, 0);
+    pwm_set_running(channel, false);
+}
+
+/******************************************************
+ * Status LED
+******************************************************/
+
+esp_err_t hal_led_init(void)
+{
+    return ws2812_led_init();
+}
+
+void hal_led_write(uint8_t red, uint8_t green, uint8_t blue)
+{
+    if (red || green || blue) {
+        ws2812_led_set_rgb(red, green, blue);
+    } else {
+        ws2812_led_clear();
+    }
+}
+
+/******************************************************
+ * Storage and network
+******************************************************/
+
+esp_err_t hal_storage_init(void)
+{
+    esp_err_t err = nvs_flash_init();
+
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        err = nvs_flash_erase();
+        if (err == ESP_OK) {
+            err = nvs_flash_init();
+        }
+    }
+    return err;
+}
+
+esp_err_t hal_wifi_init(void)
+{
+    app_wifi_init();
+    return ESP_OK;
+}
+
+esp_err_t hal_wifi_start(void)
+{
+    return app_wifi_start(POP_TYPE_RANDOM);
+}
+
+/******************************************************
+ * Cloud node
+******************************************************/
+
+static esp_rmaker_node_t *node;
+static hal_cloud_write_t cloud_write;
+static hal_cloud_connection_t cloud_connection;
+
+static esp_err_t cloud_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+    const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *context)
+{
+    int32_t value = (val.type == RMAKER_VAL_TYPE_BOOLEAN) ? val.val.b
+                  : (val.type == RMAKER_VAL_TYPE_FLOAT) ? (int32_t)val.val.f : val.val.i;
+
+    return cloud_write(priv_data, (void *)param, value,
+        context ? esp_rmaker_device_cb_src_to_str(context->src) : NULL);
+}
+
+static void cloud_event(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == RMAKER_MQTT_EVENT_CONNECTED) {
+        cloud_connection(true);
+    } else if (event_id == RMAKER_MQTT_EVENT_DISCONNECTED) {
+        cloud_connection(false);
+    }
+}
+
+esp_err_t hal_cloud_init(const char *name, const char *type, hal_cloud_write_t write,
+                         hal_cloud_connection_t connection)
+{
+    esp_rmaker_config_t rmaker_config = {
+        .enable_time_sync = false,
+    };
+
+    cloud_write = write;
+    cloud_connection = connection;
+    esp_rmaker_console_init();
+    esp_event_handler_register(RMAKER_COMMON_EVENT, ESP_EVENT_ANY_ID, cloud_event, NULL);
+
+    node = esp_rmaker_node_init(&rmaker_config, name, type);
+    return node ? ESP_OK : ESP_FAIL;
+}
+
+void *hal_cloud_device_create(const hal_cloud_device_t *desc, void *params[PAYLOAD_MAX])
+{
+    esp_rmaker_device_t *device;
+    esp_rmaker_param_t *level = NULL;
+
+    switch (desc->kind) {
+        case HAL_CLOUD_LIGHT:
+            // The on-off parameter is a boolean (true/false)
+            device = esp_rmaker_lightbulb_device_create(desc->name, desc->priv, desc->on_off);
+            level = esp_rmaker_brightness_param_create(desc->level_name, desc->level);
+            break;
+        case HAL_CLOUD_FAN:
+            device = esp_rmaker_fan_device_create(desc->name, desc->priv, desc->on_off);
+            // The speed parameter is an integer
+            level = esp_rmaker_speed_param_create(desc->level_name, desc->level);
+            break;
+        case HAL_CLOUD_SENSOR:
+            device = esp_rmaker_temp_sensor_device_create(desc->name, desc->priv, desc->reading);
+            break;
+        default:
+            device = esp_rmaker_device_create(desc->name, NULL, desc->priv);
+            break;
+    }
+    if (!device) {
+        return NULL;
+    }
+
+    esp_rmaker_device_add_cb(device, cloud_write_cb, NULL);
+    if (level) {
+        esp_rmaker_device_add_param(device, level);
+    }
+    params[PAYLOAD_ON_OFF] = esp_rmaker_device_get_param_by_type(device, ESP_RMAKER_PARAM_POWER);
+    params[PAYLOAD_LEVEL] = level;
+    params[PAYLOAD_READING] = esp_rmaker_device_get_param_by_type(device, ESP_RMAKER_PARAM_TEMPERATURE);
+    return device;
+}
+
+esp_err_t hal_cloud_device_add_attribute(void *device, const char *name, const char *value)
+{
+    return esp_rmaker_device_add_attribute(device, name, value);
+}
+
+esp_err_t hal_cloud_node_add_device(void *device)
+{
+    return esp_rmaker_node_add_device(node, device);
+}
+
+esp_err_t hal_cloud_start(void)
+{
+    /* Enable timezone service which will be require for setting appropriate timezone
+     * from the phone apps for scheduling to work correctly.
+     * For more information on the various ways of setting timezone, please check
+     * https://rainmaker.espressif.com/docs/time-service.html.
+     */
+    esp_rmaker_timezone_service_enable();
+
+    esp_rmaker_schedule_enable();
+    esp_rmaker_scenes_enable();
+
+    /* Start the ESP RainMaker Agent */
+    return esp_rmaker_start();
+}
+
+const char *hal_cloud_node_id(void)
+{
+    return esp_rmaker_get_node_id();
+}
+
+/******************************************************
+ * Cloud sink
+******************************************************/
+
+static esp_rmaker_param_val_t payload_value(const event_packet_t *event)
+{
+    switch (event->payload) {
+        case PAYLOAD_ON_OFF:
+            return esp_rmaker_bool(event->data.on_off);
+        case PAYLOAD_LEVEL:
+            return esp_rmaker_int(event->data.level);
+        default:
+            return esp_rmaker_float(event->data.reading);
+    }
+}
+
+esp_err_t hal_cloud_stage(void *param, const event_packet_t *event)
+{
+    return esp_rmaker_param_update((esp_rmaker_param_t *)param, payload_value(event));
+}
+
+esp_err_t hal_cloud_report(void)
+{
+    return esp_rmaker_report_updated_params();
+}
+
+esp_err_t hal_cloud_publish(const char *topic, const char *data, size_t len)
+{
+    return esp_rmaker_mqtt_publish(topic, (void *)data, len, RMAKER_MQTT_QOS1, NULL);
+}
+
+esp_err_t hal_cloud_reset(bool factory)
+{
+    // Reset now and reboot 2 s later, as the app_reset component does
+    return factory ? esp_rmaker_factory_reset(0, 2) : esp_rmaker_wifi_reset(0, 2);
+}
@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include "history.h"
+
+#define HISTORY_MAGIC 0x48535431 // "HST1"
+
+_Static_assert(HISTORY_BLOCK_SIZE <= UINT8_MAX, "Block length must fit the length byte");
+_Static_assert(HISTORY_PROBES_MAX <= 16, "Probe mask is 16 bits");
+
+/******************************************************
+ * Varint coding
+******************************************************/
+
+static size_t varint_put(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static size_t varint_get(const uint8_t *in, size_t len, uint32_t *value)
+{
+    uint32_t result = 0;
+
+    for (size_t n = 0; n < len && n < 5; n++) {
+        result |= (uint32_t)(in[n] & 0x7f) << (7 * n);
+        if (!(in[n] & 0x80)) {
+            *value = result;
+            return n + 1;
+        }
+    }
+    return 0; // Truncated or overlong
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/******************************************************
+ * Blocks
+******************************************************/
+
+static uint8_t *block_at(const history_t *history, size_t block)
+{
+    return history->storage + ((history->first + block) % history->block_count) * HISTORY_BLOCK_SIZE;
+}
+
+static uint8_t *open_block(const history_t *history)
+{
+    return block_at(history, history->used - 1);
+}
+
+static void block_start(history_t *history, uint32_t time)
+{
+    if (history->used == history->block_count) {
+        // Ring is full, give up the oldest block
+        uint8_t *oldest = block_at(history, 0);
+        history->dropped += history_read_block(history, 0, NULL, HISTORY_BLOCK_SAMPLES_MAX);
+        memset(oldest, 0, HISTORY_BLOCK_SIZE);
+        history->first = (history->first + 1) % history->block_count;
+        history->used--;
+    }
+    history->used++;
+
+    uint8_t *block = open_block(history);
+    block[0] = HISTORY_BLOCK_HEADER;
+    memcpy(&block[1], &time, sizeof(time));
+    history->last_time = time;
+    history->seen = 0;
+}
+
+static size_t record_encode(const history_t *history, const history_sample_t *sample, uint8_t *out)
+{
+    // The first sample of a probe in a block is delta coded against 0
+    int32_t base = (history->seen & (1u << sample->probe)) ? history->last_value[sample->probe] : 0;
+    size_t n = 0;
+
+    n += varint_put(&out[n], sample->time - history->last_time);
+    out[n++] = sample->probe;
+    n += varint_put(&out[n], zigzag((int32_t)sample->centi_percent - base));
+    return n;
+}
+
+/******************************************************
+ * Public API
+******************************************************/
+
+bool history_resume(history_t *history, uint8_t *storage, size_t size)
+{
+    uint16_t block_count = size / HISTORY_BLOCK_SIZE;
+
+    if (history->magic == HISTORY_MAGIC && history->block_count == block_count &&
+        history->first < block_count && history->used <= block_count) {
+        history->storage = storage;
+        return true;
+    }
+
+    memset(history, 0, sizeof(*history));
+    history->storage = storage;
+    history->block_count = block_count;
+    history->magic = HISTORY_MAGIC;
+    history_clear(history);
+    return false;
+}
+
+void history_clear(history_t *history)
+{
+    memset(history->storage, 0, (size_t)history->block_count * HISTORY_BLOCK_SIZE);
+    history->first = 0;
+    history->used = 0;
+    history->seen = 0;
+}
+
+void history_append(history_t *history, const history_sample_t *sample)
+{
+    uint8_t record[HISTORY_RECORD_MAX];
+
+    if (history->block_count == 0 || sample->probe >= HISTORY_PROBES_MAX) {
+        return;
+    }
+
+    // A clock that went backwards cannot be delta coded, start over from a new base time
+    if (history->used == 0 || sample->time < history->last_time) {
+        block_start(history, sample->time);
+    }
+
+    size_t len = record_encode(history, sample, record);
+    uint8_t *block = open_block(history);
+    if (block[0] + len > HISTORY_BLOCK_SIZE) {
+        block_start(history, sample->time);
+        len = record_encode(history, sample, record);
+        block = open_block(history);
+    }
+
+    memcpy(&block[block[0]], record, len);
+    block[0] += len;
+    history->last_time = sample->time;
+    history->last_value[sample->probe] = sample->centi_percent;
+    history->seen |= 1u << sample->probe;
+}
+
+size_t history_blocks(const history_t *history)
+{
+    return history->used;
+}
+
+size_t history_read_block(const history_t *history, size_t block, history_sample_t *out, size_t max)
+{
+    if (block >= history->used) {
+        return 0;
+    }
+
+    const uint8_t *data = block_at(history, block);
+    size_t end = (data[0] <= HISTORY_BLOCK_SIZE) ? data[0] : HISTORY_BLOCK_SIZE;
+    size_t pos = HISTORY_BLOCK_HEADER;
+    uint16_t last_value[HISTORY_PROBES_MAX] = {0};
+    uint32_t time, delta, value;
+    size_t count = 0;
+
+    memcpy(&time, &data[1], sizeof(time));
+
+    while (pos < end && count < max) {
+        size_t n = varint_get(&data[pos], end - pos, &delta);
+        if (n == 0 || pos + n >= end) {
+            break;
+        }
+        pos += n;
+        uint8_t probe = data[pos++];
+        n = varint_get(&data[pos], end - pos, &value);
+        if (n == 0 || probe >= HISTORY_PROBES_MAX) {
+            break;
+        }
+        pos += n;
+
+        time += delta;
+        last_value[probe] = (uint16_t)(last_value[probe] + unzigzag(value));
+        if (out) {
+            out[count] = (history_sample_t) {
+                .time = time,
+                .probe = probe,
+                .centi_percent = last_value[probe],
+            };
+        }
+        count++;
+    }
+    return count;
+}
+
+void history_drop_oldest(history_t *history, size_t count)
+{
+    if (count >= history->used) {
+        history_clear(history);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        memset(block_at(history, 0), 0, HISTORY_BLOCK_SIZE);
+        history->first = (history->first + 1) % history->block_count;
+        history->used--;
+    }
+}
+
+size_t history_bytes(const history_t *history)
+{
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < history->used; i++) {
+        bytes += block_at(history, i)[0];
+    }
+    return bytes;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Samples are packed into fixed size blocks. Each block starts with an absolute
+// timestamp and holds varint records delta coded against the previous sample of
+// the same probe, so a block decodes on its own and the oldest block can be
+// dropped whole when the ring is full
+#define HISTORY_BLOCK_SIZE      64
+#define HISTORY_PROBES_MAX      16
+
+// Length byte and 32 bit base time
+#define HISTORY_BLOCK_HEADER    5
+
+// Records are at least three bytes
+#define HISTORY_BLOCK_SAMPLES_MAX ((HISTORY_BLOCK_SIZE - HISTORY_BLOCK_HEADER) / 3)
+
+// Worst case record: time delta, probe, value delta
+#define HISTORY_RECORD_MAX      (5 + 1 + 3)
+
+typedef struct {
+    uint32_t time;              // Seconds, any monotonic base
+    uint8_t probe;              // Below HISTORY_PROBES_MAX
+    uint16_t centi_percent;     // Reading in 0.01 % units
+} history_sample_t;
+
+typedef struct {
+    uint32_t magic;
+    uint8_t *storage;
+    uint16_t block_count;
+    uint16_t first;             // Oldest block
+    uint16_t used;              // Blocks holding samples, the newest one is open for appends
+    // Encoder state of the open block
+    uint32_t last_time;
+    uint16_t last_value[HISTORY_PROBES_MAX];
+    uint16_t seen;              // Probes with a sample in the open block
+    uint32_t dropped;           // Samples lost to overwritten blocks
+} history_t;
+
+/**
+ * @brief Attach a ring to its storage, keeping samples left from before a reset when the ring is intact.
+ *
+ * @param size bytes of storage, rounded down to whole blocks
+ * @return true if earlier samples were kept
+*/
+bool history_resume(history_t *history, uint8_t *storage, size_t size);
+
+/**
+ * @brief Drop every sample.
+*/
+void history_clear(history_t *history);
+
+/**
+ * @brief Append a sample, overwriting the oldest block when the ring is full.
+*/
+void history_append(history_t *history, const history_sample_t *sample);
+
+/**
+ * @brief Number of blocks holding samples, the open block included.
+*/
+size_t history_blocks(const history_t *history);
+
+/**
+ * @brief Decode one block, 0 being the oldest.
+ *
+ * @return number of samples written to `out`, at most `max`
+*/
+size_t history_read_block(const history_t *history, size_t block, history_sample_t *out, size_t max);
+
+/**
+ * @brief Release the `count` oldest blocks once they have been sent.
+*/
+void history_drop_oldest(history_t *history, size_t count);
+
+/**
+ * @brief Bytes of encoded samples held, block headers included.
+*/
+size_t history_bytes(const history_t *history);
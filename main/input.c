@@ -0,0 +1,350 @@
+#include "input.h"
+#include "device.h"
+#include "event_queue.h"
+#include "hal.h"
+
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+typedef enum {
+    INPUT_BOOT_BUTTON = 0,  // Toggles the LED, a long hold is a Wi-Fi or factory reset
+    INPUT_PUMP_BUTTON,      // Button n toggles pump n
+    INPUT_FLOAT_SWITCH,     // Low water stops every pump
+    INPUT_FLOW_METER,       // Pulses counted in hardware, no interrupt per pulse
+} input_kind_t;
+
+typedef struct {
+    input_kind_t kind;
+    int gpio;
+    uint8_t instance;       // Pump toggled by a pump button, position in its list otherwise
+    bool active_level;      // Level while pressed or while the water is low
+    bool active;            // Debounced state
+    bool settling;          // Edges seen, waiting for the line to go quiet
+    int64_t burst_us;       // First edge of the current burst
+    int64_t last_edge_us;
+    int64_t changed_us;     // When `active` last changed, a press for buttons
+    hal_counter_t counter;
+} input_t;
+
+// Queued by the edge ISR, timestamps are taken in the ISR
+typedef struct {
+    uint8_t index;
+    bool level;
+    int64_t us;
+} input_edge_t;
+
+static const char *kind_names[] = {
+    [INPUT_BOOT_BUTTON] = "boot button",
+    [INPUT_PUMP_BUTTON] = "pump button",
+    [INPUT_FLOAT_SWITCH] = "float switch",
+    [INPUT_FLOW_METER] = "flow meter",
+};
+
+static input_t inputs[INPUT_MAX];
+static uint8_t input_count;
+static QueueHandle_t input_queue;
+static volatile uint8_t low_switches;   // Float switches reporting low water
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+static StackType_t input_task_stack[INPUT_TASK_STACK];
+static StaticTask_t input_task_buffer;
+static StaticQueue_t input_queue_buffer;
+static uint8_t input_queue_storage[INPUT_QUEUE_LEN * sizeof(input_edge_t)];
+#endif
+
+static const char *TAG = "INPUT";
+
+static void input_isr(void *arg)
+{
+    input_t *in = arg;
+    input_edge_t edge = {
+        .index = in - inputs,
+        .level = hal_gpio_read(in->gpio),
+        .us = esp_timer_get_time(),
+    };
+    BaseType_t woken = pdFALSE;
+
+    // A full queue only loses bounces, the level is read again once the line settles
+    xQueueSendFromISR(input_queue, &edge, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void report_on_off(device_desc_t *dev, event_producer_t producer)
+{
+    event_packet_t state_to_app = {
+        .direction = ESP_TO_APP,
+        .device = registry_id(dev),
+        .payload = PAYLOAD_ON_OFF,
+        .data.on_off = dev->on_off,
+    };
+    event_send(&state_to_app, producer);
+}
+
+static void water_low_cutoff(int64_t tripped_us)
+{
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+        // low_switches is already raised, a start racing with this sees it or is undone here
+        if (dev->type != DEVICE_PUMP || !stop_pump(dev)) {
+            continue;
+        }
+        ESP_LOGW(TAG, "%s stopped %" PRId64 " us after the float switch tripped", dev->name,
+                 esp_timer_get_time() - tripped_us);
+        report_on_off(dev, PRODUCER_INPUT);
+    }
+}
+
+static void button_tap(input_t *in)
+{
+    if (in->kind == INPUT_BOOT_BUTTON) {
+        toggle_onBoard_led();
+        return;
+    }
+
+    device_desc_t *pump = registry_find(DEVICE_PUMP, in->instance);
+    if (pump) {
+        // set_pump() keeps it off if the water is low, report what it really did
+        set_pump(pump, !pump->on_off);
+        report_on_off(pump, PRODUCER_BUTTON);
+    }
+}
+
+/**
+ * @brief Boot button released, a long hold resets the Wi-Fi credentials or the whole node.
+*/
+static void boot_button_release(input_t *in, int64_t held_us)
+{
+    if (held_us >= (int64_t)FACTORY_RESET_BUTTON_TIMEOUT * 1000000) {
+        ESP_LOGW(TAG, "Boot button held %" PRId64 " ms, factory reset", held_us / 1000);
+        hal_cloud_reset(true);
+    } else if (held_us >= (int64_t)WIFI_RESET_BUTTON_TIMEOUT * 1000000) {
+        ESP_LOGW(TAG, "Boot button held %" PRId64 " ms, Wi-Fi reset", held_us / 1000);
+        hal_cloud_reset(false);
+    } else {
+        button_tap(in);
+    }
+}
+
+static void input_changed(input_t *in, bool active, int64_t us)
+{
+    int64_t held_us = us - in->changed_us;
+
+    in->active = active;
+    in->changed_us = us;
+
+    switch (in->kind) {
+        case INPUT_BOOT_BUTTON:
+            // Act on release, once the hold time is known
+            if (!active) {
+                boot_button_release(in, held_us);
+            }
+            break;
+        case INPUT_PUMP_BUTTON:
+            // A long hold is not a tap, as on the boot button
+            if (!active && held_us < (int64_t)WIFI_RESET_BUTTON_TIMEOUT * 1000000) {
+                button_tap(in);
+            }
+            break;
+        case INPUT_FLOAT_SWITCH:
+            if (active) {
+                low_switches++;
+                water_low_cutoff(us);
+            } else {
+                low_switches--;
+                ESP_LOGI(TAG, "Float switch %u: water back", in->instance);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void input_edge(input_t *in, const input_edge_t *edge)
+{
+    if (!in->settling) {
+        in->settling = true;
+        in->burst_us = edge->us;
+    }
+    in->last_edge_us = edge->us;
+
+    // Low water is acted on at its first edge, only the all clear waits for the switch to settle
+    if (in->kind == INPUT_FLOAT_SWITCH && !in->active && edge->level == in->active_level) {
+        input_changed(in, true, edge->us);
+    }
+}
+
+/**
+ * @brief Take the level of every input that has been quiet for the debounce time.
+ *
+ * @return ticks until the next input settles, portMAX_DELAY if none is settling
+*/
+static TickType_t input_settle(void)
+{
+    const int64_t debounce_us = (int64_t)INPUT_DEBOUNCE_MS * 1000;
+    int64_t now = esp_timer_get_time();
+    int64_t next_us = INT64_MAX;
+
+    for (uint8_t i = 0; i < input_count; i++) {
+        input_t *in = &inputs[i];
+        if (!in->settling) {
+            continue;
+        }
+
+        int64_t quiet_us = now - in->last_edge_us;
+        if (quiet_us < debounce_us) {
+            next_us = (debounce_us - quiet_us < next_us) ? debounce_us - quiet_us : next_us;
+            continue;
+        }
+        in->settling = false;
+        bool active = (hal_gpio_read(in->gpio) == in->active_level);
+        if (active != in->active) {
+            input_changed(in, active, in->burst_us);
+        }
+    }
+
+    if (next_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    // Round up, waking early would only find the input still settling
+    TickType_t wait = pdMS_TO_TICKS((next_us + 999) / 1000);
+    return wait ? wait : 1;
+}
+
+/**
+ * @brief Debounce by waiting on the edge queue, no timer runs while the inputs are quiet.
+*/
+static void input_task(void *arg)
+{
+    TickType_t wait = portMAX_DELAY;
+    input_edge_t edge;
+
+    while (true) {
+        if (xQueueReceive(input_queue, &edge, wait) == pdTRUE) {
+            input_edge(&inputs[edge.index], &edge);
+        }
+        wait = input_settle();
+    }
+}
+
+static void input_add(input_kind_t kind, int gpio, uint8_t instance, bool active_level)
+{
+    if (input_count >= INPUT_MAX) {
+        ESP_LOGE(TAG, "Too many inputs, GPIO %d dropped", gpio);
+        return;
+    }
+
+    input_t *in = &inputs[input_count];
+    *in = (input_t) {
+        .kind = kind,
+        .gpio = gpio,
+        .instance = instance,
+        .active_level = active_level,
+    };
+
+    esp_err_t err;
+    if (kind == INPUT_FLOW_METER) {
+        err = hal_counter_init(gpio, &in->counter);
+    } else {
+        err = hal_gpio_input(gpio, true, input_isr, in);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not set up %s on GPIO %d: %s", kind_names[kind], gpio, esp_err_to_name(err));
+        return;
+    }
+    input_count++;
+
+    // Start from the current level, a reservoir may already be low at boot
+    if (kind == INPUT_FLOAT_SWITCH && hal_gpio_read(gpio) == active_level) {
+        in->active = true;
+        in->changed_us = esp_timer_get_time();
+        low_switches++;
+        ESP_LOGW(TAG, "Float switch %u: water low, pumps held off", instance);
+    }
+}
+
+static void input_add_list(input_kind_t kind, const char *list, bool active_level)
+{
+    int gpios[INPUT_MAX];
+    int count = registry_parse_list(list, gpios, INPUT_MAX);
+
+    for (int i = 0; i < count; i++) {
+        input_add(kind, gpios[i], i, active_level);
+    }
+}
+
+void input_init(void)
+{
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    input_queue = xQueueCreateStatic(INPUT_QUEUE_LEN, sizeof(input_edge_t), input_queue_storage,
+                    &input_queue_buffer);
+#else
+    input_queue = xQueueCreate(INPUT_QUEUE_LEN, sizeof(input_edge_t));
+#endif
+    if (!input_queue) {
+        ESP_LOGE(TAG, "Could not create input queue");
+        return;
+    }
+
+    // Edges may arrive as soon as the first ISR is attached, the task must be ready
+    TaskHandle_t task = NULL;
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    task = xTaskCreateStaticPinnedToCore(input_task, "input_task", INPUT_TASK_STACK, NULL,
+                    INPUT_TASK_PRIORITY, input_task_stack, &input_task_buffer, APP_TASK_CORE);
+#else
+    xTaskCreatePinnedToCore(input_task, "input_task", INPUT_TASK_STACK, NULL,
+                    INPUT_TASK_PRIORITY, &task, APP_TASK_CORE);
+#endif
+    if (!task) {
+        ESP_LOGE(TAG, "Could not create input task");
+        return;
+    }
+
+    input_add(INPUT_BOOT_BUTTON, BUTTON_GPIO, 0, BUTTON_ACTIVE_LEVEL);
+    input_add_list(INPUT_PUMP_BUTTON, CONFIG_EXAMPLE_PUMP_BUTTON_GPIOS, BUTTON_ACTIVE_LEVEL);
+    input_add_list(INPUT_FLOAT_SWITCH, CONFIG_EXAMPLE_FLOAT_SWITCH_GPIOS, FLOAT_SWITCH_LOW_LEVEL);
+    input_add_list(INPUT_FLOW_METER, CONFIG_EXAMPLE_FLOW_METER_GPIOS, true);
+}
+
+bool input_water_low(void)
+{
+    return low_switches > 0;
+}
+
+void input_log(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "%-13s %4s %-8s %12s", "input", "gpio", "state", "since (ms)");
+    for (uint8_t i = 0; i < input_count; i++) {
+        const input_t *in = &inputs[i];
+        if (in->kind == INPUT_FLOW_METER) {
+            ESP_LOGI(TAG, "%-11s %u %4d %" PRId32 " pulses", kind_names[in->kind], in->instance, in->gpio,
+                     hal_counter_read(in->counter));
+            continue;
+        }
+        ESP_LOGI(TAG, "%-11s %u %4d %-8s %12" PRId64, kind_names[in->kind], in->instance, in->gpio,
+                 in->kind == INPUT_FLOAT_SWITCH ? (in->active ? "low" : "ok") : (in->active ? "pressed" : "released"),
+                 in->changed_us ? (now - in->changed_us) / 1000 : -1);
+    }
+}
+
+static int input_cmd(int argc, char **argv)
+{
+    input_log();
+    return 0;
+}
+
+void input_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "inputs",
+        .help = "State of every button and float switch, and flow meter pulse counts",
+        .func = input_cmd,
+    };
+    esp_console_cmd_register(&cmd);
+}
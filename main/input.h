@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sdkconfig.h>
+
+// Inputs are buttons, reservoir float switches and flow meters on the GPIOs listed in Kconfig
+#define INPUT_MAX           16
+#define INPUT_QUEUE_LEN     16
+#define INPUT_TASK_STACK    3072
+// Above every other app task, a low water cutoff preempts whatever is running
+#define INPUT_TASK_PRIORITY 6
+
+#define INPUT_DEBOUNCE_MS   CONFIG_EXAMPLE_INPUT_DEBOUNCE_MS
+#define FLOAT_SWITCH_LOW_LEVEL CONFIG_EXAMPLE_FLOAT_SWITCH_LOW_LEVEL
+
+/**
+ * @brief Set up every configured input and the task that debounces them.
+ *
+ * Call after registry_init() and before the pumps are set up, so a reservoir
+ * that is already low keeps them off from the start.
+*/
+void input_init(void);
+
+/**
+ * @brief Whether any float switch reports low water, pumps must not run while it does.
+*/
+bool input_water_low(void);
+
+void input_log(void);
+
+/**
+ * @brief Register the "inputs" console command.
+ * Call after esp_rmaker_console_init().
+*/
+void input_register_console(void);
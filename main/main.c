@@ -3,15 +3,31 @@
 #include "packet.h"
 #include "device.h"
 #include "rainMaker.h"
+#include "event_queue.h"
+#include "power.h"
+#include "persist.h"
+#include "controller.h"
+#include "boot.h"
+#include "dlog.h"
 
 static const char *TAG = "MAIN";
 #define INITIAL_POWER_STATE false
 #define INITIAL_SENSOR_READING 20.0
 
-QueueHandle_t event_queue = NULL;
-
 #define DELAY(x) vTaskDelay(x / portTICK_PERIOD_MS)
 
+#define NETWORK_TASK_STACK 4096
+#define NETWORK_TASK_PRIORITY 3
+#define EVENT_TASK_STACK 4096
+#define EVENT_TASK_PRIORITY 4
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+static StackType_t network_task_stack[NETWORK_TASK_STACK];
+static StaticTask_t network_task_buffer;
+static StackType_t event_task_stack[EVENT_TASK_STACK];
+static StaticTask_t event_task_buffer;
+#endif
+
 void flash_led() 
 {
     while (true) {
@@ -22,34 +38,127 @@ void flash_led()
     }
 }
 
+static void dispatch_event(const event_packet_t *event)
+{
+    DLOGI(DLOG_TAG_MAIN, TAG, "Receive dir (%d), dev (%d)", event->direction, event->device);
+
+    if (event->direction == ESP_TO_APP) {
+        rainMaker_update(event);
+    } else if (event->direction == APP_TO_ESP) {
+        hardware_update(event);
+        rainMaker_echo(event);
+    }
+}
+
 void queue_processing()
 {
-    event_packet_t event = {0};
+    TickType_t wait = portMAX_DELAY;
 
     while (true) {
-        DELAY(1000);
-
-        if (xQueueReceive(event_queue, &event, 100) == pdTRUE) {
-            ESP_LOGI(TAG, "Receive dir (%d), dev (%d)", event.direction, event.device);
-            
-            if (event.direction == ESP_TO_APP) {
-                rainMaker_update(event);
-            } else if (event.direction == APP_TO_ESP) {
-                hardware_update(event);
-            }
+        // Sleeps only when both lanes are empty and no report is due, commands are served first
+        const event_packet_t *event = event_receive(wait);
+        if (event) {
+            dispatch_event(event);
+            event_release(event);
         }
+        wait = rainMaker_flush();
+
+        // Pump run-time limits, every pump change wakes this task
+        TickType_t control_wait = controller_poll();
+        wait = (control_wait < wait) ? control_wait : wait;
+
+        // Deep sleep needs both lanes drained and every report sent
+        TickType_t power_wait = power_poll(!event && wait == portMAX_DELAY);
+        wait = (power_wait < wait) ? power_wait : wait;
+
+        // Pending state writes do not hold off deep sleep, RTC memory keeps the state
+        TickType_t persist_wait = persist_poll();
+        wait = (persist_wait < wait) ? persist_wait : wait;
+    }
+}
+
+/**
+ * @brief Event consumer, owns the lanes so it must be the task that creates them.
+*/
+static void event_task(void *arg)
+{
+    event_queue_init();
+    // Lanes exist, let app_main bring up the devices that post to them
+    xTaskNotifyGive((TaskHandle_t)arg);
+    queue_processing();
+}
+
+/**
+ * @brief Full RainMaker bring-up, off the main task since wifi_start() blocks until connected.
+*/
+static void network_task(void *arg)
+{
+    wifi_init();
+    rainMaker_init();
+    rm_add_devices(DEVICE_LED);
+    rm_add_devices(DEVICE_PUMP);
+    rm_add_devices(DEVICE_SENSOR);
+    rainMaker_start();
+    wifi_start();
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Connect in the background while local sampling and control keep running.
+*/
+void network_start(void)
+{
+    TaskHandle_t task = NULL;
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    static bool started = false;
+
+    // The task deletes itself but its stack and control block are reused, start it once
+    if (started) {
+        return;
+    }
+    started = true;
+    task = xTaskCreateStaticPinnedToCore(network_task, "network_task", NETWORK_TASK_STACK, NULL,
+                    NETWORK_TASK_PRIORITY, network_task_stack, &network_task_buffer, NETWORK_TASK_CORE);
+#else
+    xTaskCreatePinnedToCore(network_task, "network_task", NETWORK_TASK_STACK, NULL,
+                    NETWORK_TASK_PRIORITY, &task, NETWORK_TASK_CORE);
+#endif
+    if (!task) {
+        ESP_LOGE(TAG, "Could not create network task");
     }
 }
 
 void app_main()
 {
+    boot_mark(BOOT_APP_MAIN);
+    dlog_init();
+
+    // Create command and telemetry lanes and their consumer on the app core.
+    // Devices may report as soon as they are initialised
+    TaskHandle_t events = NULL;
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    events = xTaskCreateStaticPinnedToCore(event_task, "event_task", EVENT_TASK_STACK, xTaskGetCurrentTaskHandle(),
+                    EVENT_TASK_PRIORITY, event_task_stack, &event_task_buffer, APP_TASK_CORE);
+#else
+    xTaskCreatePinnedToCore(event_task, "event_task", EVENT_TASK_STACK, xTaskGetCurrentTaskHandle(),
+                    EVENT_TASK_PRIORITY, &events, APP_TASK_CORE);
+#endif
+    if (!events) {
+        ESP_LOGE(TAG, "Could not create event task");
+        return;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
     /* Initialize Application specific hardware drivers and
      * set initial state.
      */
     hardware_init(INITIAL_POWER_STATE, INITIAL_SENSOR_READING);
+    boot_mark(BOOT_HARDWARE);
 
     // Workshop Part 1: Blink on-board LED & Change LED color
-    flash_led();
+        // flash_led() never returns and takes over the status LED, the network below would not start
+    // flash_led();
     
     ESP_LOGI(TAG, "Hardware initialization complete");
 
@@ -73,7 +182,7 @@ void app_main()
         // Task: Add a "school name" attribute to the device
     // wifi_init();
     // rainMaker_init();
-    // rm_add_light_switch(INITIAL_POWER_STATE);
+    // rm_add_devices(DEVICE_LED);
     // rainMaker_start();
     // wifi_start();
 
@@ -81,17 +190,17 @@ void app_main()
         // Task: Fix the sensor reading (why is it inconsistent? Hint: device.c)
     // wifi_init();
     // rainMaker_init();
-    // rm_add_light_switch(INITIAL_POWER_STATE);
-    // rm_add_sensor(INITIAL_SENSOR_READING);
+    // rm_add_devices(DEVICE_LED);
+    // rm_add_devices(DEVICE_SENSOR);
     // rainMaker_start();
     // wifi_start();
 
     // Workshop Part 5: Add water pump
     // wifi_init();
     // rainMaker_init();
-    // rm_add_light_switch(INITIAL_POWER_STATE);
-    // rm_add_water_pump(INITIAL_POWER_STATE);
-    // rm_add_sensor(INITIAL_SENSOR_READING);
+    // rm_add_devices(DEVICE_LED);
+    // rm_add_devices(DEVICE_PUMP);
+    // rm_add_devices(DEVICE_SENSOR);
     // rainMaker_start();
     // wifi_start();
 
@@ -100,7 +209,10 @@ void app_main()
             // 1. Add a "wetness" attribute to the sensor that changes based on the perceived wetness
             // 2. Make the water pump turn on when the wetness crosses a certain threshold
 
-    // Create input processing queue
-    event_queue = xQueueCreate(50, sizeof(event_packet_t));
-    queue_processing(); 
+    // Fast boot: the Part 5 sequence runs from network_start() in the background,
+    // sampling and control are already running and events queue up meanwhile.
+    // With deep sleep selected, only bring the network up when it is due
+    if (power_network_due()) {
+        network_start();
+    }
 }
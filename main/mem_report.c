@@ -0,0 +1,69 @@
+#include "mem_report.h"
+
+#include <stdlib.h>
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <esp_console.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const char *TAG = "MEM";
+
+static void heap_log(const char *name, uint32_t caps)
+{
+    ESP_LOGI(TAG, "%-9s free %7u  largest block %7u  min ever free %7u", name,
+        (unsigned)heap_caps_get_free_size(caps), (unsigned)heap_caps_get_largest_free_block(caps),
+        (unsigned)heap_caps_get_minimum_free_size(caps));
+}
+
+#ifdef CONFIG_FREERTOS_USE_TRACE_FACILITY
+static void stacks_log(void)
+{
+    // Headroom for tasks created between counting and sampling
+    UBaseType_t max = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *tasks = malloc(max * sizeof(TaskStatus_t));
+
+    if (!tasks) {
+        ESP_LOGE(TAG, "Out of memory");
+        return;
+    }
+    UBaseType_t count = uxTaskGetSystemState(tasks, max, NULL);
+
+    // High-water mark is the least free stack seen, in bytes on ESP-IDF
+    ESP_LOGI(TAG, "%-16s %4s %10s", "task", "prio", "stack free");
+    for (UBaseType_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "%-16s %4u %10lu", tasks[i].pcTaskName, (unsigned)tasks[i].uxCurrentPriority,
+            (unsigned long)tasks[i].usStackHighWaterMark);
+    }
+    free(tasks);
+}
+#else
+static void stacks_log(void)
+{
+    ESP_LOGW(TAG, "Enable CONFIG_FREERTOS_USE_TRACE_FACILITY for per-task stack usage");
+}
+#endif
+
+void mem_report_log(void)
+{
+    heap_log("internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    heap_log("all 8-bit", MALLOC_CAP_8BIT);
+    stacks_log();
+}
+
+static int mem_report_cmd(int argc, char **argv)
+{
+    mem_report_log();
+    return 0;
+}
+
+void mem_report_register_console(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "mem-report",
+        .help = "Free heap, largest free block, minimum ever free heap and per-task stack high-water marks",
+        .func = mem_report_cmd,
+    };
+    esp_console_cmd_register(&cmd);
+}
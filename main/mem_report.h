@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * @brief Log heap usage and the stack high-water mark of every task.
+*/
+void mem_report_log(void);
+
+/**
+ * @brief Register the "mem-report" console command.
+ * Call after esp_rmaker_console_init().
+*/
+void mem_report_register_console(void);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <freertos/task.h>
@@ -11,20 +13,40 @@ enum {
     APP_TO_ESP = 1,
 };
 
-// Device target
+// Device type
 enum {
     DEVICE_LED = 0,
     DEVICE_PUMP,
     DEVICE_SENSOR,
-}; 
+    DEVICE_TYPE_MAX,
+};
+
+// Device target, event_packet_t.device is an index into the device registry
+#define DEVICE_MAX 16
+
+// Payload carried in event_packet_t.data
+enum {
+    PAYLOAD_ON_OFF = 0,     // data.on_off
+    PAYLOAD_LEVEL,          // data.level, LED brightness or pump speed
+    PAYLOAD_READING,        // data.reading, sensor value
+    PAYLOAD_MAX,
+};
 
-// Packet structure
+// Packet structure, `payload` selects the active member of `data`
 typedef struct {
     uint8_t direction;
     uint8_t device;
-    uint8_t data_on_off;
-    uint8_t data_light_brightness;
-    uint8_t data_pump_speed;
-    float data_sensor;
-    bool is_on_off;
-} event_packet_t;
\ No newline at end of file
+    uint8_t payload;
+    uint8_t reserved;
+    union {
+        bool on_off;
+        uint8_t level;
+        float reading;
+    } data;
+    uint32_t enqueued_us;   // Set by event_send(), low 32 bits of esp_timer_get_time()
+} event_packet_t;
+
+// Queues copy packets by value, keep them small and free of padding
+_Static_assert(offsetof(event_packet_t, data) == 4, "event_packet_t header must be 4 bytes");
+_Static_assert(offsetof(event_packet_t, enqueued_us) == 8, "event_packet_t timestamp must follow data");
+_Static_assert(sizeof(event_packet_t) == 12, "event_packet_t must stay 12 bytes");
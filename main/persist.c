@@ -0,0 +1,277 @@
+#include "persist.h"
+#include "controller.h"
+#include "event_queue.h"
+#include "power.h"
+
+#include <string.h>
+#include <esp_log.h>
+#include <nvs.h>
+
+#define PERSIST_NAMESPACE   "app_state"
+#define PERSIST_KEY         "state"
+// Bump when persist_image_t changes, older images are ignored
+#define PERSIST_VERSION     1
+
+// Time for one commit to be earned back
+#define PERSIST_REFILL_MS   (3600000UL / PERSIST_WRITES_PER_HOUR)
+
+typedef struct {
+    uint8_t type;           // Checked on restore, the device table may have changed
+    uint8_t instance;
+    uint8_t on_off;
+    uint8_t level;
+    float reading;
+} persist_device_t;
+
+typedef struct {
+    uint16_t version;
+    uint8_t count;
+    persist_device_t devices[DEVICE_MAX];
+    float dry;
+    float wet;
+    uint32_t min_on_ms;     // Milliseconds, the tick rate may differ between builds
+    uint32_t min_off_ms;
+    uint32_t max_run_ms;
+} persist_image_t;
+
+#ifdef CONFIG_EXAMPLE_PERSIST
+static const char *TAG = "PERSIST";
+
+// Last image read from or written to flash, unchanged images are not written again
+static persist_image_t stored;
+static bool stored_valid = false;
+
+static portMUX_TYPE persist_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool started = false;
+static bool state_dirty = false;
+static bool sample_dirty = false;
+static TickType_t dirty_since;
+static bool write_failed = false;   // Only touched by the event consumer
+static TickType_t failed_at;
+
+// Token bucket bounding flash wear, only touched by the event consumer
+static uint8_t tokens;
+static TickType_t refilled;
+
+static void persist_snapshot(persist_image_t *image)
+{
+    controller_config_t config;
+
+    memset(image, 0, sizeof(*image));
+    image->version = PERSIST_VERSION;
+    image->count = registry_count();
+    for (uint8_t id = 0; id < image->count; id++) {
+        device_desc_t *dev = registry_get(id);
+        image->devices[id] = (persist_device_t) {
+            .type = dev->type,
+            .instance = registry_instance(dev),
+            .on_off = dev->on_off,
+            .level = dev->level,
+            .reading = dev->reading,
+        };
+    }
+
+    controller_get_config(&config);
+    image->dry = config.dry;
+    image->wet = config.wet;
+    image->min_on_ms = pdTICKS_TO_MS(config.min_on);
+    image->min_off_ms = pdTICKS_TO_MS(config.min_off);
+    image->max_run_ms = pdTICKS_TO_MS(config.max_run);
+}
+
+static esp_err_t persist_write(const persist_image_t *image)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(PERSIST_NAMESPACE, NVS_READWRITE, &handle);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, PERSIST_KEY, image, sizeof(*image));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+void persist_init(void)
+{
+    nvs_handle_t handle;
+    size_t length = sizeof(stored);
+
+    // A wake from deep sleep spends its single commit on state changes, samples wait for a refill
+    tokens = power_resumed() ? 1 : PERSIST_BURST;
+    refilled = xTaskGetTickCount();
+
+    if (nvs_open(PERSIST_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No saved state");
+        return;
+    }
+    esp_err_t err = nvs_get_blob(handle, PERSIST_KEY, &stored, &length);
+    nvs_close(handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "No saved state");
+        return;
+    }
+    if (err != ESP_OK || length != sizeof(stored) || stored.version != PERSIST_VERSION
+        || stored.count > DEVICE_MAX) {
+        ESP_LOGW(TAG, "Saved state does not match this build, ignored");
+        return;
+    }
+    stored_valid = true;
+
+    controller_config_t config;
+    controller_get_config(&config);
+    config.dry = stored.dry;
+    config.wet = stored.wet;
+    config.min_on = pdMS_TO_TICKS(stored.min_on_ms);
+    config.min_off = pdMS_TO_TICKS(stored.min_off_ms);
+    config.max_run = pdMS_TO_TICKS(stored.max_run_ms);
+    controller_set_config(&config);
+    ESP_LOGI(TAG, "Restored state of %u devices", stored.count);
+}
+
+void persist_restore(device_desc_t *dev)
+{
+    uint8_t id = registry_id(dev);
+
+    if (!stored_valid || id >= stored.count) {
+        return;
+    }
+    const persist_device_t *saved = &stored.devices[id];
+    if (saved->type != dev->type || saved->instance != registry_instance(dev)) {
+        return;
+    }
+    dev->on_off = saved->on_off;
+    dev->level = saved->level;
+    dev->reading = saved->reading;
+}
+
+void persist_start(void)
+{
+    portENTER_CRITICAL(&persist_lock);
+    started = true;
+    portEXIT_CRITICAL(&persist_lock);
+}
+
+void persist_mark_dirty(persist_kind_t kind)
+{
+    bool first = false;
+
+    portENTER_CRITICAL(&persist_lock);
+    if (started) {
+        first = !state_dirty && !sample_dirty;
+        if (first) {
+            dirty_since = xTaskGetTickCount();
+        }
+        if (kind == PERSIST_STATE) {
+            state_dirty = true;
+        } else {
+            sample_dirty = true;
+        }
+    }
+    portEXIT_CRITICAL(&persist_lock);
+
+    // The consumer may be blocked with nothing else to do, let it schedule the write
+    if (first) {
+        event_queue_wake();
+    }
+}
+
+TickType_t persist_poll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t refill = pdMS_TO_TICKS(PERSIST_REFILL_MS);
+    bool state, sample;
+    TickType_t since;
+
+    while (tokens < PERSIST_BURST && now - refilled >= refill) {
+        tokens++;
+        refilled += refill;
+    }
+
+    portENTER_CRITICAL(&persist_lock);
+    state = state_dirty;
+    sample = sample_dirty;
+    since = dirty_since;
+    portEXIT_CRITICAL(&persist_lock);
+
+    if (!state && !sample) {
+        return portMAX_DELAY;
+    }
+
+    // Let a burst of changes settle into one write
+    TickType_t settle = pdMS_TO_TICKS(PERSIST_COMMIT_DELAY_MS);
+    if (now - since < settle) {
+        return settle - (now - since);
+    }
+
+    TickType_t retry = pdMS_TO_TICKS(PERSIST_RETRY_MS);
+    if (write_failed && now - failed_at < retry) {
+        return retry - (now - failed_at);
+    }
+
+    // Samples only use commits the state changes would not miss
+    uint8_t needed = state ? 1 : PERSIST_BURST;
+    if (tokens < needed) {
+        return refill - (now - refilled);
+    }
+
+    portENTER_CRITICAL(&persist_lock);
+    state_dirty = false;
+    sample_dirty = false;
+    portEXIT_CRITICAL(&persist_lock);
+
+    persist_image_t image;
+    persist_snapshot(&image);
+    if (stored_valid && memcmp(&image, &stored, sizeof(image)) == 0) {
+        return portMAX_DELAY;
+    }
+
+    esp_err_t err = persist_write(&image);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not save state: %s", esp_err_to_name(err));
+        // Keep the change pending, changes marked meanwhile are merged in
+        portENTER_CRITICAL(&persist_lock);
+        state_dirty |= state;
+        sample_dirty |= sample;
+        portEXIT_CRITICAL(&persist_lock);
+        write_failed = true;
+        failed_at = now;
+        return retry;
+    }
+    write_failed = false;
+    stored = image;
+    stored_valid = true;
+
+    // A full bucket starts refilling from now, not from when it filled up
+    if (tokens == PERSIST_BURST) {
+        refilled = now;
+    }
+    tokens--;
+    ESP_LOGD(TAG, "State saved, %u writes left in burst", tokens);
+    return portMAX_DELAY;
+}
+#else
+void persist_init(void)
+{
+}
+
+void persist_restore(device_desc_t *dev)
+{
+}
+
+void persist_start(void)
+{
+}
+
+void persist_mark_dirty(persist_kind_t kind)
+{
+}
+
+TickType_t persist_poll(void)
+{
+    return portMAX_DELAY;
+}
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+
+#include "registry.h"
+
+#ifdef CONFIG_EXAMPLE_PERSIST
+#define PERSIST_WRITES_PER_HOUR CONFIG_EXAMPLE_PERSIST_WRITES_PER_HOUR
+#else
+#define PERSIST_WRITES_PER_HOUR 12
+#endif
+
+// Changes arriving within this window are written together
+#define PERSIST_COMMIT_DELAY_MS 2000
+// Wait before trying again after a failed write
+#define PERSIST_RETRY_MS        30000
+// Commits that may go out back to back before the hourly rate applies
+#define PERSIST_BURST           3
+
+// What changed, a sample alone never spends the burst reserve kept for state changes
+typedef enum {
+    PERSIST_STATE = 0,      // Actuator state or controller thresholds
+    PERSIST_SAMPLE,         // A new good sensor reading
+} persist_kind_t;
+
+/**
+ * @brief Load the saved image from the `nvs` partition and restore the controller thresholds.
+ * Call after storage_init() and before any device is set up.
+*/
+void persist_init(void);
+
+/**
+ * @brief Restore a device's saved state, does nothing if none was saved for it.
+*/
+void persist_restore(device_desc_t *dev);
+
+/**
+ * @brief Start tracking changes, the restore itself is not written back.
+ * Call once every device is set up.
+*/
+void persist_start(void);
+
+/**
+ * @brief Note that state changed, the write is deferred and coalesced with later changes.
+ * Safe to call from any task.
+*/
+void persist_mark_dirty(persist_kind_t kind);
+
+/**
+ * @brief Write pending changes once they have settled and the hourly budget allows it.
+ * Called from the event consumer.
+ *
+ * @return ticks until the next write may be due, portMAX_DELAY if nothing is pending
+*/
+TickType_t persist_poll(void);
@@ -0,0 +1,161 @@
+#include "power.h"
+#include "device.h"
+#include "controller.h"
+#include "rainMaker.h"
+#include "event_queue.h"
+#include "hal.h"
+
+#include <esp_attr.h>
+#include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+
+// State carried across deep sleep, RTC_DATA_ATTR is reset on every other kind of boot
+typedef struct {
+    uint32_t sample_period_ms;
+    uint32_t wakes;             // Timer wakes since the network was last brought up
+    struct {
+        bool on_off;
+        uint8_t level;
+        float reading;
+    } devices[DEVICE_MAX];
+} power_rtc_t;
+
+RTC_DATA_ATTR static power_rtc_t rtc_state;
+
+static bool resumed = false;
+static bool network_due = true;
+
+#ifdef CONFIG_EXAMPLE_POWER_DEEP_SLEEP
+static volatile bool scan_done = false;
+static volatile uint32_t next_period_ms;
+static bool idle_seen = false;
+static TickType_t idle_since;
+#endif
+
+static const char *TAG = "POWER";
+
+void power_init(void)
+{
+    resumed = (esp_reset_reason() == ESP_RST_DEEPSLEEP);
+    ESP_LOGI(TAG, "%s", resumed ? "Resumed from deep sleep" : "Cold boot");
+
+#ifdef CONFIG_EXAMPLE_POWER_DEEP_SLEEP
+    // The button wakes the node for interaction, so it always comes online
+    bool timer_wake = (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
+    network_due = !resumed || !timer_wake || rtc_state.wakes + 1 >= POWER_NETWORK_EVERY;
+    if (!network_due) {
+        ESP_LOGI(TAG, "Network skipped, %lu wakes since last connection", (unsigned long)(rtc_state.wakes + 1));
+    }
+#endif
+
+#ifdef CONFIG_EXAMPLE_POWER_LIGHT_SLEEP
+    // Tickless idle drops into light sleep whenever every task is blocked,
+    // Wi-Fi keeps its association through modem sleep
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not enable light sleep: %s", esp_err_to_name(err));
+    }
+#endif
+}
+
+bool power_resumed(void)
+{
+    return resumed;
+}
+
+void power_restore(device_desc_t *dev)
+{
+    if (!resumed) {
+        return;
+    }
+    uint8_t id = registry_id(dev);
+    dev->on_off = rtc_state.devices[id].on_off;
+    dev->level = rtc_state.devices[id].level;
+    dev->reading = rtc_state.devices[id].reading;
+}
+
+uint32_t power_sample_period_ms(uint32_t fallback)
+{
+    return (resumed && rtc_state.sample_period_ms) ? rtc_state.sample_period_ms : fallback;
+}
+
+bool power_network_due(void)
+{
+    return network_due;
+}
+
+#ifdef CONFIG_EXAMPLE_POWER_DEEP_SLEEP
+static void power_deep_sleep(uint32_t period_ms)
+{
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+
+        rtc_state.devices[id].on_off = dev->on_off;
+        rtc_state.devices[id].level = dev->level;
+        rtc_state.devices[id].reading = dev->reading;
+        // Digital pads float in deep sleep, latch the relays in their off state
+        if (dev->type == DEVICE_PUMP) {
+            pump_prepare_sleep(dev);
+            hal_gpio_hold(dev->gpio, true);
+        }
+    }
+    hal_gpio_hold_in_sleep();
+
+    rtc_state.sample_period_ms = period_ms;
+    rtc_state.wakes = network_due ? 0 : rtc_state.wakes + 1;
+
+    esp_sleep_enable_timer_wakeup((uint64_t)period_ms * 1000);
+    esp_sleep_enable_ext0_wakeup(BUTTON_GPIO, BUTTON_ACTIVE_LEVEL);
+
+    ESP_LOGI(TAG, "Deep sleep for %lu s", (unsigned long)(period_ms / 1000));
+    esp_deep_sleep_start();
+}
+#endif
+
+void power_scan_done(uint32_t period_ms)
+{
+#ifdef CONFIG_EXAMPLE_POWER_DEEP_SLEEP
+    next_period_ms = period_ms;
+    scan_done = true;
+    // The consumer may be blocked with nothing to do, let it check for sleep
+    event_queue_wake();
+#endif
+}
+
+TickType_t power_poll(bool idle)
+{
+#ifdef CONFIG_EXAMPLE_POWER_DEEP_SLEEP
+    TickType_t now = xTaskGetTickCount();
+
+    // A running pump needs the node awake, the next scan decides again
+    if (!scan_done || controller_watering()) {
+        scan_done = false;
+        return portMAX_DELAY;
+    }
+    // On a network wake, hold on until MQTT came up and the history went out
+    if (network_due && !rainMaker_connected() && now < pdMS_TO_TICKS(POWER_NETWORK_TIMEOUT_MS)) {
+        return pdMS_TO_TICKS(POWER_NETWORK_TIMEOUT_MS) - now;
+    }
+    if (!idle) {
+        idle_seen = false;
+        return portMAX_DELAY;
+    }
+    if (!idle_seen) {
+        idle_seen = true;
+        idle_since = now;
+    }
+    if (now - idle_since < pdMS_TO_TICKS(POWER_SLEEP_GRACE_MS)) {
+        return pdMS_TO_TICKS(POWER_SLEEP_GRACE_MS) - (now - idle_since);
+    }
+
+    power_deep_sleep(next_period_ms);
+#endif
+    return portMAX_DELAY;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+
+#include "registry.h"
+
+// Deep sleep waits this long after the last report so the MQTT publish can leave
+#define POWER_SLEEP_GRACE_MS        2000
+
+#ifdef CONFIG_EXAMPLE_POWER_DEEP_SLEEP
+// Wakes between network connections, and how long a network wake may wait for MQTT
+#define POWER_NETWORK_EVERY         CONFIG_EXAMPLE_POWER_NETWORK_EVERY
+#define POWER_NETWORK_TIMEOUT_MS    (CONFIG_EXAMPLE_POWER_NETWORK_TIMEOUT_S * 1000)
+#endif
+
+/**
+ * @brief Find out why the chip booted and enable automatic light sleep when configured.
+ * Call before any device is set up.
+*/
+void power_init(void);
+
+/**
+ * @brief Whether this boot is a wake from deep sleep with state kept in RTC memory.
+*/
+bool power_resumed(void);
+
+/**
+ * @brief Restore a device's state from before deep sleep, does nothing on a cold boot.
+*/
+void power_restore(device_desc_t *dev);
+
+/**
+ * @brief Sample period in use before deep sleep, `fallback` on a cold boot.
+*/
+uint32_t power_sample_period_ms(uint32_t fallback);
+
+/**
+ * @brief Whether this wake should bring up Wi-Fi and RainMaker.
+ *
+ * In deep sleep mode only every POWER_NETWORK_EVERY-th timer wake does, the
+ * others sample, run the controller and go back to sleep with readings kept
+ * in the offline history.
+*/
+bool power_network_due(void);
+
+/**
+ * @brief Called by the sensor task once a scan has finished.
+ *
+ * @param period_ms time until the next scan, used as the deep sleep duration
+*/
+void power_scan_done(uint32_t period_ms);
+
+/**
+ * @brief Enter deep sleep once the node has nothing left to do, called from the event consumer.
+ *
+ * @param idle true when no event and no report are pending
+ * @return ticks until the next check is due, portMAX_DELAY if none
+*/
+TickType_t power_poll(bool idle);
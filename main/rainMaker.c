@@ -1,28 +1,80 @@
-#include "rainMaker.h"
-
-extern QueueHandle_t event_queue;
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <esp_attr.h>
 
-esp_rmaker_node_t *end_node; 
-esp_rmaker_device_t *light_device;
-esp_rmaker_device_t *water_pump_device;
-esp_rmaker_device_t *sensor_device;
+#include "rainMaker.h"
+#include "device.h"
+#include "event_queue.h"
+#include "boot.h"
+#include "cpu_load.h"
+#include "mem_report.h"
+#include "hal.h"
+#include "dlog.h"
+#include "input.h"
 
 static const char *TAG = "rainMaker";
 
+static esp_err_t rm_add_light_switch(device_desc_t *dev);
+static esp_err_t rm_add_water_pump(device_desc_t *dev);
+static esp_err_t rm_add_sensor(device_desc_t *dev);
+static void rm_report_param(device_desc_t *dev, const event_packet_t *event);
+
+const device_rm_ops_t light_rm_ops = {
+    .add = rm_add_light_switch,
+    .report = rm_report_param,
+};
+
+const device_rm_ops_t pump_rm_ops = {
+    .add = rm_add_water_pump,
+    .report = rm_report_param,
+};
+
+const device_rm_ops_t sensor_rm_ops = {
+    .add = rm_add_sensor,
+    .report = rm_report_param,
+};
+
+// Change needed before a param is reported again, negative reports every update.
+// Actuator params are also written by the app, so they are never filtered here
+static const float report_deadband[PAYLOAD_MAX] = {
+    [PAYLOAD_ON_OFF] = -1.0f,
+    [PAYLOAD_LEVEL] = -1.0f,
+    [PAYLOAD_READING] = REPORT_DEADBAND,
+};
+
+typedef struct {
+    float value;
+    bool valid;
+} reported_value_t;
+
+// Only touched from the event consumer task
+static reported_value_t reported[DEVICE_MAX][PAYLOAD_MAX];
+static bool report_pending;
+static bool report_sent;
+static TickType_t batch_start;
+static TickType_t last_report;     // Last publish of params or history, for the rate limit
+static bool report_failed;
+static volatile bool mqtt_connected;
+
+#ifdef CONFIG_EXAMPLE_HISTORY
+// Survives deep sleep and software resets, history_resume() checks it is intact
+RTC_NOINIT_ATTR static uint8_t history_storage[HISTORY_SIZE];
+RTC_NOINIT_ATTR static history_t history;
+#endif
+
 /******************************************************
  * Rainmaker configuration functions
 ******************************************************/
 
 void wifi_init()
 {
-    /* Initialize Non-Volatile Storage. */
-    esp_err_t err = nvs_flash_init();
-    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ESP_ERROR_CHECK(nvs_flash_init());
-    }
-    /* Initialize Wi-Fi. Note that, this should be called before esp_rmaker_node_init() */
-    app_wifi_init();
+    /* Initialize Non-Volatile Storage, usually already done by hardware_init(). */
+    storage_init();
+    /* Initialize Wi-Fi. Note that, this should be called before rainMaker_init() */
+    hal_wifi_init();
+    boot_mark(BOOT_WIFI_INIT);
 }
 
 void wifi_start()
@@ -32,217 +84,440 @@ void wifi_start()
      * else, it will start Wi-Fi provisioning. The function will return
      * after a connection has been successfully established
      */
-    esp_err_t err = app_wifi_start(POP_TYPE_RANDOM);
+    esp_err_t err = hal_wifi_start();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Could not start Wifi. Aborting!!!");
         vTaskDelay(5000/portTICK_PERIOD_MS);
         abort();
     }
+    boot_mark(BOOT_WIFI_CONNECTED);
 }
 
-esp_rmaker_node_t* rainMaker_init() 
-{   
-    /* Initialize the ESP RainMaker Agent.
-     * Note that this should be called after app_wifi_init() but before app_wifi_start()
-     * */
-    esp_rmaker_console_init();
+/**
+ * @brief Track the MQTT connection, the history is only published while connected.
+*/
+static void rm_connection(bool connected)
+{
+    mqtt_connected = connected;
+    status_led_set_offline(!connected);
+    if (connected) {
+        boot_mark(BOOT_MQTT_CONNECTED);
+        // Let the consumer start flushing history right away
+        event_queue_wake();
+    }
+}
 
-    esp_rmaker_config_t rmaker_config = {
-        .enable_time_sync = false,
-    };
+#ifdef CONFIG_EXAMPLE_HISTORY
+/**
+ * @brief Attach the RTC ring once, readings can arrive before RainMaker is set up.
+*/
+static void history_attach(void)
+{
+    static bool attached = false;
 
-    end_node = esp_rmaker_node_init(&rmaker_config, 
-        "NUS IEEE Workshop", "Multiple Devices");
+    if (!attached) {
+        attached = true;
+        if (history_resume(&history, history_storage, sizeof(history_storage))) {
+            ESP_LOGI(TAG, "Kept %u blocks of sensor history", (unsigned)history_blocks(&history));
+        }
+    }
+}
+#endif
 
-    if (!end_node) {
+static esp_err_t rm_param_write(void *priv, void *param, int32_t value, const char *source);
+
+void rainMaker_init() 
+{   
+    /* Initialize the ESP RainMaker Agent.
+     * Note that this should be called after wifi_init() but before wifi_start()
+     * */
+    if (hal_cloud_init("NUS IEEE Workshop", "Multiple Devices", rm_param_write, rm_connection) != ESP_OK) {
         ESP_LOGE(TAG, "Could not initialise node. Aborting!!!");
         vTaskDelay(5000 / portTICK_PERIOD_MS);
         abort();
     }
+    event_queue_register_console();
+    boot_register_console();
+    cpu_load_register_console();
+    mem_report_register_console();
+    dlog_register_console();
+    input_register_console();
+
+#ifdef CONFIG_EXAMPLE_HISTORY
+    history_attach();
+#endif
+
     ESP_LOGI(TAG, "RainMaker initialization complete, please add devices & services");
-    return end_node;
+    boot_mark(BOOT_RAINMAKER_INIT);
 }
 
 void rainMaker_start()
 {
-    /* Enable timezone service which will be require for setting appropriate timezone
-     * from the phone apps for scheduling to work correctly.
-     * For more information on the various ways of setting timezone, please check
-     * https://rainmaker.espressif.com/docs/time-service.html.
-     */
-    esp_rmaker_timezone_service_enable();
-    
-    esp_rmaker_schedule_enable();
-    esp_rmaker_scenes_enable();
-
-    /* Start the ESP RainMaker Agent */
-    esp_rmaker_start();
+    /* Timezone, schedules and scenes, then the ESP RainMaker Agent */
+    hal_cloud_start();
+    boot_mark(BOOT_RAINMAKER_START);
 
     return;
 }
 
-void rainMaker_update(event_packet_t event) 
+void rainMaker_update(const event_packet_t *event) 
 {   
-    switch (event.device) {
-        case DEVICE_LED:
-            // Update the light device
-            esp_rmaker_param_update_and_report(
-                esp_rmaker_device_get_param_by_type(light_device, ESP_RMAKER_PARAM_POWER),
-                esp_rmaker_bool(event.data_on_off)
-            );
-            break;
-        case DEVICE_PUMP:
-            // Update the pump device
-            // fallthrough for now
-            break;
-        case DEVICE_SENSOR:
-            // Update the sensor device
-            esp_rmaker_param_update_and_report(
-                esp_rmaker_device_get_param_by_type(sensor_device, ESP_RMAKER_PARAM_TEMPERATURE),
-                esp_rmaker_float(event.data_sensor)
-            );
-            break;
-        default:
-            break;
+    device_desc_t *dev = registry_get(event->device);
+
+    if (!dev) {
+        return;
+    }
+
+#ifdef CONFIG_EXAMPLE_HISTORY
+    // Readings sent while offline would be lost, keep them until the connection is back.
+    // This includes deep sleep wakes that never bring RainMaker up
+    if (!mqtt_connected && event->payload == PAYLOAD_READING) {
+        history_attach();
+        float centi = event->data.reading * 100.0f;
+        history_sample_t sample = {
+            .time = (uint32_t)time(NULL),
+            .probe = registry_instance(dev),
+            .centi_percent = (centi < 0.0f) ? 0 : (centi > 10000.0f) ? 10000 : (uint16_t)centi,
+        };
+        history_append(&history, &sample);
+    }
+#endif
+
+    // Devices not added to the node have nothing to report to
+    if (dev->rm_device) {
+        dev->rm->report(dev, event);
     }
-    return;
 }
 
-/******************************************************
- * On Board LED functions
-******************************************************/
-esp_err_t rm_add_dummy()
+bool rainMaker_connected(void)
 {
-    esp_rmaker_device_t* dummy = esp_rmaker_device_create("Dummy Device", NULL, NULL);
-    
-    esp_rmaker_device_add_cb(dummy, NULL, NULL);
-    esp_rmaker_device_add_attribute(dummy, "Hello", "from ESP32!");
-    esp_rmaker_node_add_device(end_node, dummy); 
-    return ESP_OK;
+    return mqtt_connected;
 }
 
 /**
- * @brief Callback to handle commands received from Rainmaker cloud on the LED device.
+ * @brief Ticks left until @p period has passed since @p since, 0 once it has.
 */
-static esp_err_t light_sw_callback(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param_label,
-    const esp_rmaker_param_val_t value, void *private_data, esp_rmaker_write_ctx_t *context)
+static TickType_t ticks_left(TickType_t since, uint32_t period_ms, TickType_t now)
 {
-    if (context) {
-        ESP_LOGI(TAG, "Received write request from %s", esp_rmaker_device_cb_src_to_str(context->src));
-    }
+    TickType_t elapsed = now - since;
+    TickType_t period = pdMS_TO_TICKS(period_ms);
 
-    const char *device_name = esp_rmaker_device_get_name(device);
-    const char *param_name = esp_rmaker_param_get_name(param_label);
-    ESP_LOGI(TAG, "Device: %s, Param: %s", device_name, param_name);
+    return (elapsed < period) ? period - elapsed : 0;
+}
 
-    // If turning the light on/off
-    if (strcmp(param_name, PARAM_NAME_ON_OFF) == 0) {
-        ESP_LOGI(TAG, "Received on-off: %s", value.val.b ? "true" : "false");
-        // (Send to event queue)
-        event_packet_t led_on_off = {
-            .direction =  APP_TO_ESP,
-            .device = DEVICE_LED,
-            .data_on_off = value.val.b,
-        };
-        xQueueSend(event_queue, &led_on_off, 0);
+#ifdef CONFIG_EXAMPLE_HISTORY
+/**
+ * @brief Publish the oldest history blocks as one JSON message.
+ *
+ * Samples are [probe, age in seconds, reading in 0.01 %], the age lets the
+ * receiver place them without the node having a synced clock.
+*/
+static TickType_t history_flush(void)
+{
+    size_t blocks = history_blocks(&history);
+    TickType_t now = xTaskGetTickCount();
+
+    if (blocks == 0 || !mqtt_connected) {
+        return portMAX_DELAY;
+    }
+    // Shares the node-wide rate limit with param reports
+    if (report_sent) {
+        TickType_t rate_wait = ticks_left(last_report, REPORT_MIN_INTERVAL_MS, now);
+        if (rate_wait > 0) {
+            return rate_wait;
+        }
+    }
+    if (blocks > HISTORY_FLUSH_BLOCKS) {
+        blocks = HISTORY_FLUSH_BLOCKS;
+    }
 
-    } else if (strcmp(param_name, PARAM_NAME_LED) == 0) {
-        ESP_LOGI(TAG, "Received brightness: %d", value.val.i);
-        // TODO: Send to event queue, hardware side to differentiate between on/off and speed
+    // Worst case "[15,4294967295,10000]," per sample
+    const size_t size = 32 + blocks * HISTORY_BLOCK_SAMPLES_MAX * 24;
+    char *json = malloc(size);
+    if (!json) {
+        return pdMS_TO_TICKS(HISTORY_FLUSH_GAP_MS);
+    }
 
+    history_sample_t samples[HISTORY_BLOCK_SAMPLES_MAX];
+    uint32_t wall = (uint32_t)time(NULL);
+    size_t len = snprintf(json, size, "{\"history\":[");
+    for (size_t b = 0; b < blocks; b++) {
+        size_t count = history_read_block(&history, b, samples, HISTORY_BLOCK_SAMPLES_MAX);
+        for (size_t i = 0; i < count; i++) {
+            len += snprintf(json + len, size - len, "[%u,%lu,%u],", samples[i].probe,
+                (unsigned long)(wall - samples[i].time), samples[i].centi_percent);
+        }
+    }
+    if (json[len - 1] == ',') {
+        len--;
+    }
+    len += snprintf(json + len, size - len, "]}");
 
+    char topic[64];
+    snprintf(topic, sizeof(topic), "node/%s/history", hal_cloud_node_id());
+    if (hal_cloud_publish(topic, json, len) == ESP_OK) {
+        history_drop_oldest(&history, blocks);
     } else {
-        ESP_LOGE(TAG, "Unknown param received");
-        return ESP_OK; //Silently ignore unknown param
+        ESP_LOGW(TAG, "Could not publish history");
     }
+    free(json);
+    report_sent = true;
+    last_report = now;
 
-    esp_rmaker_param_update_and_report(param_label, value);
-    return ESP_OK;
+    return history_blocks(&history) ? pdMS_TO_TICKS(HISTORY_FLUSH_GAP_MS) : portMAX_DELAY;
+}
+#endif
+
+/**
+ * @brief Report staged param updates once the batch window and rate limit allow it.
+*/
+static TickType_t params_flush(void)
+{
+    if (!report_pending) {
+        return portMAX_DELAY;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = ticks_left(batch_start, REPORT_BATCH_MS, now);
+    if (report_sent) {
+        TickType_t rate_wait = ticks_left(last_report, REPORT_MIN_INTERVAL_MS, now);
+        wait = (rate_wait > wait) ? rate_wait : wait;
+    }
+    if (report_failed) {
+        TickType_t retry_wait = ticks_left(last_report, REPORT_RETRY_MS, now);
+        wait = (retry_wait > wait) ? retry_wait : wait;
+    }
+    if (wait > 0) {
+        return wait;
+    }
+
+    // One publish carries every param updated since the last report
+    report_sent = true;
+    last_report = now;
+    if (hal_cloud_report() != ESP_OK) {
+        // The params stay staged, try again with whatever is added meanwhile
+        ESP_LOGW(TAG, "Could not report params");
+        report_failed = true;
+        return pdMS_TO_TICKS(REPORT_RETRY_MS);
+    }
+    if (mqtt_connected) {
+        boot_mark(BOOT_FIRST_REPORT);
+    }
+    report_pending = false;
+    report_failed = false;
+    return portMAX_DELAY;
 }
 
-esp_err_t rm_add_light_switch(bool initial_state)
+TickType_t rainMaker_flush(void)
 {
-    // The on-off parameter is a boolean (true/false)
-    light_device = esp_rmaker_lightbulb_device_create("Onboard LED", NULL, initial_state);
+    TickType_t wait = params_flush();
+#ifdef CONFIG_EXAMPLE_HISTORY
+    TickType_t history_wait = history_flush();
+    wait = (history_wait < wait) ? history_wait : wait;
+#endif
+    return wait;
+}
 
-    esp_rmaker_device_add_cb(light_device, light_sw_callback, NULL);
+esp_err_t rm_add_devices(uint8_t type)
+{
+    esp_err_t err = ESP_OK;
+
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+        if (dev->type == type && dev->rm->add(dev) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not add %s", dev->name);
+            err = ESP_FAIL;
+        }
+    }
+    return err;
+}
 
-    const esp_rmaker_param_t *param = esp_rmaker_brightness_param_create(PARAM_NAME_LED, DEFAULT_LIGHT_BRIGHTNESS);
-    esp_rmaker_device_add_param(light_device, param);
+static float rm_payload_number(const event_packet_t *event)
+{
+    switch (event->payload) {
+        case PAYLOAD_ON_OFF:
+            return event->data.on_off;
+        case PAYLOAD_LEVEL:
+            return event->data.level;
+        default:
+            return event->data.reading;
+    }
+}
 
-    esp_rmaker_device_add_attribute(light_device, "Serial Number", "1234");
-    // Hint: add attribute here
+static void rm_report_param(device_desc_t *dev, const event_packet_t *event)
+{
+    if (event->payload >= PAYLOAD_MAX || !dev->rm_params[event->payload]) {
+        return;
+    }
 
-    return esp_rmaker_node_add_device(end_node, light_device);
+    reported_value_t *last = &reported[event->device][event->payload];
+    float value = rm_payload_number(event);
+    if (last->valid && fabsf(value - last->value) < report_deadband[event->payload]) {
+        return;
+    }
+    last->value = value;
+    last->valid = true;
+
+    // Update the local copy only, rainMaker_flush() reports it with the rest of the batch
+    hal_cloud_stage(dev->rm_params[event->payload], event);
+    if (!report_pending) {
+        report_pending = true;
+        batch_start = xTaskGetTickCount();
+    }
+}
+
+void rainMaker_echo(const event_packet_t *command)
+{
+    device_desc_t *dev = registry_get(command->device);
+    event_packet_t state = {
+        .direction = ESP_TO_APP,
+        .device = command->device,
+        .payload = command->payload,
+    };
+
+    if (!dev) {
+        return;
+    }
+    // The device's own state, a refused command echoes what really happened
+    if (command->payload == PAYLOAD_ON_OFF) {
+        state.data.on_off = dev->on_off;
+    } else if (command->payload == PAYLOAD_LEVEL) {
+        state.data.level = dev->level;
+    } else {
+        return;
+    }
+    rm_report_param(dev, &state);
 }
 
 /******************************************************
- * Water Pump Functions
+ * Param write dispatch
 ******************************************************/
 
 /**
- * @brief Callback to handle commands received from RainMaker cloud on the water pump device.
+ * @brief Turn a param write into a command on the event pipeline.
+ * The event consumer echoes the applied state back with the next batched report, see rainMaker_echo().
 */
-static esp_err_t water_p_callback(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param_label,
-    const esp_rmaker_param_val_t value, void *private_data, esp_rmaker_write_ctx_t *context)
+static esp_err_t rm_param_write(void *priv, void *param, int32_t value, const char *source)
 {
-    if (context) {
-        ESP_LOGI(TAG, "Received write request from %s", esp_rmaker_device_cb_src_to_str(context->src));
-    }
+    // priv is the device_desc_t the cloud device was created with
+    device_desc_t *dev = priv;
 
-    const char *device_name = esp_rmaker_device_get_name(device);
-    const char *param_name = esp_rmaker_param_get_name(param_label);
-    ESP_LOGI(TAG, "Device: %s, Param: %s", device_name, param_name);
-
-    // If turning on-off the pump
-    if (strcmp(param_name, PARAM_NAME_ON_OFF) == 0) {
-        ESP_LOGI(TAG, "Received on-off: %s", value.val.b ? "true" : "false");
-        // Send to event queue)
-        event_packet_t pump_on_off = {
-            .direction =  APP_TO_ESP,
-            .device = DEVICE_PUMP,
-            .data_on_off = value.val.b,
-        };
-        xQueueSend(event_queue, &pump_on_off, 0);
-    } else if (strcmp(param_name, PARAM_NAME_PUMP) == 0) {
-        ESP_LOGI(TAG, "Received pump speed: %d", value.val.i);
-        // TODO: Send to event queue, hardware side to differentiate between on/off and speed
+    if (source) {
+        DLOGI(DLOG_TAG_RAINMAKER, TAG, "Received write request from %s", source);
+    }
 
-    } else {
+    // The device's own handles, at most one per payload kind
+    uint8_t payload = 0;
+    while (payload < PAYLOAD_MAX && dev->rm_params[payload] != param) {
+        payload++;
+    }
+    if (payload == PAYLOAD_MAX || payload == PAYLOAD_READING) {
         ESP_LOGE(TAG, "Unknown param received");
         return ESP_OK; //Silently ignore unknown param
     }
 
-    esp_rmaker_param_update_and_report(param_label, value);
+    event_packet_t command = {
+        .direction = APP_TO_ESP,
+        .device = registry_id(dev),
+        .payload = payload,
+    };
+
+    if (payload == PAYLOAD_ON_OFF) {
+        DLOGI(DLOG_TAG_RAINMAKER, TAG, "%s received on-off: %s", dev->name, value ? "true" : "false");
+        command.data.on_off = (value != 0);
+    } else {
+        DLOGI(DLOG_TAG_RAINMAKER, TAG, "%s received level: %d", dev->name, (int)value);
+        command.data.level = (value < 0) ? 0 : (value > UINT8_MAX) ? UINT8_MAX : value;
+    }
+    event_send(&command, (dev->type == DEVICE_PUMP) ? PRODUCER_APP_PUMP : PRODUCER_APP_LIGHT);
     return ESP_OK;
 }
 
-esp_err_t rm_add_water_pump(bool initial_state)
+/******************************************************
+ * On Board LED functions
+******************************************************/
+esp_err_t rm_add_dummy()
+{
+    const hal_cloud_device_t desc = {
+        .kind = HAL_CLOUD_PLAIN,
+        .name = "Dummy Device",
+    };
+    void *params[PAYLOAD_MAX];
+    void *dummy = hal_cloud_device_create(&desc, params);
+
+    if (!dummy) {
+        return ESP_FAIL;
+    }
+    hal_cloud_device_add_attribute(dummy, "Hello", "from ESP32!");
+    return hal_cloud_node_add_device(dummy);
+}
+
+static esp_err_t rm_add_light_switch(device_desc_t *dev)
 {
-    // The on-off parameter is a boolean (true/false)
-    water_pump_device = esp_rmaker_fan_device_create("Water Pump", NULL, initial_state);
+    const hal_cloud_device_t desc = {
+        .kind = HAL_CLOUD_LIGHT,
+        .name = dev->name,
+        .level_name = PARAM_NAME_LED,
+        .priv = dev,
+        .on_off = dev->on_off,
+        .level = dev->level,
+    };
 
-    esp_rmaker_device_add_cb(water_pump_device, water_p_callback, NULL);
-    // The speed parameter is an integer
-    const esp_rmaker_param_t *param = esp_rmaker_speed_param_create(PARAM_NAME_PUMP, DEFAULT_PUMP_SPEED);
-    esp_rmaker_device_add_param(water_pump_device, param );
+    dev->rm_device = hal_cloud_device_create(&desc, dev->rm_params);
+    if (!dev->rm_device) {
+        return ESP_FAIL;
+    }
 
-    esp_rmaker_device_add_attribute(water_pump_device, "Pump Model", "ABCD");
+    hal_cloud_device_add_attribute(dev->rm_device, "Serial Number", "1234");
     // Hint: add attribute here
 
-    return esp_rmaker_node_add_device(end_node, water_pump_device);
+    return hal_cloud_node_add_device(dev->rm_device);
 }
 
 /******************************************************
- * Sensor functions
+ * Water Pump Functions
 ******************************************************/
 
-esp_err_t rm_add_sensor(float initial_state)
+static esp_err_t rm_add_water_pump(device_desc_t *dev)
 {
-    sensor_device = esp_rmaker_temp_sensor_device_create("Soil Moisture Sensor", NULL, initial_state);
-    char* note = "The sensor is wrongly labeled as temperature for now";
-    esp_rmaker_device_add_attribute(sensor_device, "Note", note);
+    const hal_cloud_device_t desc = {
+        .kind = HAL_CLOUD_FAN,
+        .name = dev->name,
+        .level_name = PARAM_NAME_PUMP,
+        .priv = dev,
+        .on_off = dev->on_off,
+        .level = dev->level,
+    };
+
+    dev->rm_device = hal_cloud_device_create(&desc, dev->rm_params);
+    if (!dev->rm_device) {
+        return ESP_FAIL;
+    }
 
-    return esp_rmaker_node_add_device(end_node, sensor_device);
+    hal_cloud_device_add_attribute(dev->rm_device, "Pump Model", "ABCD");
+    // Hint: add attribute here
+
+    return hal_cloud_node_add_device(dev->rm_device);
 }
 
+/******************************************************
+ * Sensor functions
+******************************************************/
+
+static esp_err_t rm_add_sensor(device_desc_t *dev)
+{
+    const hal_cloud_device_t desc = {
+        .kind = HAL_CLOUD_SENSOR,
+        .name = dev->name,
+        .priv = dev,
+        .reading = dev->reading,
+    };
+
+    dev->rm_device = hal_cloud_device_create(&desc, dev->rm_params);
+    if (!dev->rm_device) {
+        return ESP_FAIL;
+    }
+    hal_cloud_device_add_attribute(dev->rm_device, "Note", "The sensor is wrongly labeled as temperature for now");
+
+    return hal_cloud_node_add_device(dev->rm_device);
+}
@@ -1,26 +1,30 @@
 #pragma once
 
 #include <string.h>
-#include <nvs_flash.h>
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
 
-#include <esp_rmaker_core.h>
-#include <esp_rmaker_standard_params.h>
-#include <esp_rmaker_standard_devices.h>
-#include <esp_rmaker_standard_types.h>
-#include <esp_rmaker_schedule.h>
-#include <esp_rmaker_scenes.h>
-#include <esp_rmaker_console.h>
-
-#include <app_wifi.h>
 #include "packet.h"
+#include "registry.h"
+#include "history.h"
 
 #define DEFAULT_PUMP_SPEED 3
 #define DEFAULT_LIGHT_BRIGHTNESS 25
 
-#define PARAM_NAME_ON_OFF ESP_RMAKER_DEF_POWER_NAME
+// Reporting stage, see rainMaker_update()
+#define REPORT_DEADBAND             (CONFIG_EXAMPLE_REPORT_DEADBAND / 10.0f)
+#define REPORT_BATCH_MS             CONFIG_EXAMPLE_REPORT_BATCH_MS
+#define REPORT_MIN_INTERVAL_MS      CONFIG_EXAMPLE_REPORT_MIN_INTERVAL_MS
+// Wait before staged params are reported again after a failed report
+#define REPORT_RETRY_MS             1000
+
+// Offline history, flushed to node/<node_id>/history once connected
+#define HISTORY_SIZE                CONFIG_EXAMPLE_HISTORY_SIZE
+#define HISTORY_FLUSH_BLOCKS        CONFIG_EXAMPLE_HISTORY_FLUSH_BLOCKS
+#define HISTORY_FLUSH_GAP_MS        1000
+
 #define PARAM_NAME_LED "LED Brightness"
 #define PARAM_NAME_PUMP "Water Pump Speed"
 
@@ -28,16 +32,41 @@ void wifi_init(void);
 
 void wifi_start(void);
 
-esp_rmaker_node_t* rainMaker_init(void);
+void rainMaker_init(void);
 
 void rainMaker_start(void);
 
-void rainMaker_update(event_packet_t event);
+/**
+ * @brief Stage a device update for the next report. Updates are batched, see rainMaker_flush().
+*/
+void rainMaker_update(const event_packet_t *event);
 
-esp_err_t rm_add_dummy();
+/**
+ * @brief Stage the state a command from the app left its device in, so the app
+ * sees what was applied. Goes out with the next batched report.
+*/
+void rainMaker_echo(const event_packet_t *command);
 
-esp_err_t rm_add_light_switch(bool initial_state);
+/**
+ * @brief Send the staged updates once the batch window and rate limit allow it.
+ *
+ * @return Ticks until the next call is due, portMAX_DELAY when nothing is staged
+*/
+TickType_t rainMaker_flush(void);
 
-esp_err_t rm_add_water_pump(bool initial_state);
+/**
+ * @brief Whether the MQTT connection to the cloud is up.
+*/
+bool rainMaker_connected(void);
+
+// RainMaker ops referenced by the device registry
+extern const device_rm_ops_t light_rm_ops;
+extern const device_rm_ops_t pump_rm_ops;
+extern const device_rm_ops_t sensor_rm_ops;
+
+esp_err_t rm_add_dummy();
 
-esp_err_t rm_add_sensor(float initial_state);
\ No newline at end of file
+/**
+ * @brief Add every registered device of the given type (DEVICE_*) to the node
+*/
+esp_err_t rm_add_devices(uint8_t type);
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+#include "device.h"
+#include "sensor.h"
+#include "rainMaker.h"
+
+#define LED_ENTRY(dev_name) \
+    { .type = DEVICE_LED, .name = dev_name, .gpio = -1, .adc_channel = -1, \
+      .level = DEFAULT_LIGHT_BRIGHTNESS, .hw = &led_hw_ops, .rm = &light_rm_ops }
+
+#define PUMP_ENTRY(dev_name, relay_gpio) \
+    { .type = DEVICE_PUMP, .name = dev_name, .gpio = relay_gpio, .adc_channel = -1, \
+      .level = DEFAULT_PUMP_SPEED, .hw = &pump_hw_ops, .rm = &pump_rm_ops }
+
+#define SENSOR_ENTRY(dev_name, power_gpio, channel) \
+    { .type = DEVICE_SENSOR, .name = dev_name, .gpio = power_gpio, .adc_channel = channel, \
+      .hw = &sensor_hw_ops, .rm = &sensor_rm_ops }
+
+/**
+ * Fixed devices on this node, a new bed is one more PUMP_ENTRY line, e.g.
+ *   PUMP_ENTRY("Water Pump 2", 11),
+ * Soil probes are listed in Kconfig (EXAMPLE_SENSOR_ADC_CHANNELS) and appended by registry_init().
+*/
+static const device_desc_t fixed_devices[] = {
+    LED_ENTRY("Onboard LED"),
+#ifdef CONFIG_EXAMPLE_ENABLE_PUMP
+    PUMP_ENTRY("Water Pump", RELAY_GPIO),
+#endif
+};
+
+#define FIXED_COUNT (sizeof(fixed_devices) / sizeof(fixed_devices[0]))
+
+_Static_assert(FIXED_COUNT <= DEVICE_MAX, "Too many devices, raise DEVICE_MAX in packet.h");
+
+static device_desc_t registry[DEVICE_MAX];
+static uint8_t registry_used;
+
+int registry_parse_list(const char *list, int *out, int max)
+{
+    int count = 0;
+    char *end;
+
+    while (*list && count < max) {
+        long value = strtol(list, &end, 0);
+        if (end == list) {
+            break;
+        }
+        out[count++] = (int)value;
+        list = end;
+        while (*list == ',' || *list == ' ') {
+            list++;
+        }
+    }
+    return count;
+}
+
+#ifdef CONFIG_EXAMPLE_ENABLE_SENSOR
+#define SENSOR_NAME_LEN 32
+
+static char sensor_names[DEVICE_MAX][SENSOR_NAME_LEN];
+
+static const char *TAG = "REGISTRY";
+
+static void registry_add_sensors(void)
+{
+    int channels[DEVICE_MAX];
+    int gpios[DEVICE_MAX];
+    int channel_count = registry_parse_list(CONFIG_EXAMPLE_SENSOR_ADC_CHANNELS, channels, DEVICE_MAX);
+    int gpio_count = registry_parse_list(CONFIG_EXAMPLE_SENSOR_POWER_GPIOS, gpios, DEVICE_MAX);
+
+    if (gpio_count == 0) {
+        ESP_LOGE(TAG, "No sensor power GPIO configured");
+        return;
+    }
+
+    for (int i = 0; i < channel_count; i++) {
+        if (registry_used >= DEVICE_MAX) {
+            ESP_LOGE(TAG, "Registry full, dropping %d probe(s)", channel_count - i);
+            return;
+        }
+
+        // Probes past the end of the GPIO list share its last pin
+        char *name = sensor_names[registry_used];
+        if (i == 0) {
+            snprintf(name, SENSOR_NAME_LEN, "Soil Moisture Sensor");
+        } else {
+            snprintf(name, SENSOR_NAME_LEN, "Soil Moisture Sensor %d", i + 1);
+        }
+        registry[registry_used++] = (device_desc_t) SENSOR_ENTRY(name,
+            gpios[(i < gpio_count) ? i : gpio_count - 1], channels[i]);
+    }
+}
+#endif
+
+void registry_init(void)
+{
+    memcpy(registry, fixed_devices, sizeof(fixed_devices));
+    registry_used = FIXED_COUNT;
+
+#ifdef CONFIG_EXAMPLE_ENABLE_SENSOR
+    registry_add_sensors();
+#endif
+}
+
+uint8_t registry_count(void)
+{
+    return registry_used;
+}
+
+device_desc_t *registry_get(uint8_t id)
+{
+    return (id < registry_used) ? &registry[id] : NULL;
+}
+
+uint8_t registry_id(const device_desc_t *dev)
+{
+    return (uint8_t)(dev - registry);
+}
+
+device_desc_t *registry_find(uint8_t type, uint8_t instance)
+{
+    for (uint8_t id = 0; id < registry_used; id++) {
+        if (registry[id].type == type && instance-- == 0) {
+            return &registry[id];
+        }
+    }
+    return NULL;
+}
+
+uint8_t registry_instance(const device_desc_t *dev)
+{
+    uint8_t instance = 0;
+    for (const device_desc_t *it = registry; it < dev; it++) {
+        instance += (it->type == dev->type);
+    }
+    return instance;
+}
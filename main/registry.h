@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "packet.h"
+
+typedef struct device_desc device_desc_t;
+
+// Hardware side of a device type, implemented in device.c
+typedef struct {
+    esp_err_t (*init)(device_desc_t *dev);
+    void (*apply)(device_desc_t *dev, const event_packet_t *event);
+} device_hw_ops_t;
+
+// Cloud side of a device type, implemented in rainMaker.c
+typedef struct {
+    esp_err_t (*add)(device_desc_t *dev);
+    void (*report)(device_desc_t *dev, const event_packet_t *event);
+} device_rm_ops_t;
+
+// One entry per physical device instance on the node
+struct device_desc {
+    uint8_t type;               // DEVICE_*
+    const char *name;           // RainMaker device name, unique on the node
+    int gpio;                   // Relay or sensor power pin, -1 if unused
+    int adc_channel;            // Sensor input, -1 if unused
+    const device_hw_ops_t *hw;
+    const device_rm_ops_t *rm;
+    // RainMaker handles, opaque outside rainMaker.c so the registry builds without the SDK
+    void *rm_device;            // esp_rmaker_device_t
+    void *rm_params[PAYLOAD_MAX];   // esp_rmaker_param_t per payload kind, NULL if absent
+
+    // Last applied or sampled state
+    bool on_off;
+    uint8_t level;
+    float reading;
+};
+
+/**
+ * @brief Fill the registry from the fixed device table and the Kconfig probe lists.
+ * Must run before any other registry call.
+*/
+void registry_init(void);
+
+/**
+ * @brief Number of registered devices, valid ids are 0 .. registry_count() - 1
+*/
+uint8_t registry_count(void);
+
+/**
+ * @brief Look up a device by its id (the `device` field of event packets).
+ *
+ * @return the descriptor, or NULL if the id is out of range
+*/
+device_desc_t *registry_get(uint8_t id);
+
+uint8_t registry_id(const device_desc_t *dev);
+
+/**
+ * @brief Find the n-th registered instance of a device type.
+ *
+ * @return the descriptor, or NULL if there are not that many instances
+*/
+device_desc_t *registry_find(uint8_t type, uint8_t instance);
+
+/**
+ * @brief Position of a device among the registered instances of its type,
+ * the inverse of registry_find().
+*/
+uint8_t registry_instance(const device_desc_t *dev);
+
+/**
+ * @brief Parse a comma separated list of integers from Kconfig, e.g. "0,1, 3".
+ *
+ * @return number of values written to `out`
+*/
+int registry_parse_list(const char *list, int *out, int max);
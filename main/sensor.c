@@ -0,0 +1,586 @@
+#include "sensor.h"
+#include "event_queue.h"
+#include "controller.h"
+#include "power.h"
+#include "persist.h"
+#include "boot.h"
+#include "hal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <nvs_flash.h>
+#include <nvs.h>
+#include <freertos/timers.h>
+
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#ifdef CONFIG_EXAMPLE_SENSOR_ACQ_CONTINUOUS
+#include "esp_adc/adc_continuous.h"
+#endif
+
+#include "sensor_cal.h"
+
+#ifdef CONFIG_EXAMPLE_SENSOR_ACQ_CONTINUOUS
+#include "sensor_filter.h"
+#endif
+
+// Acquisition steps, the task only ever blocks between them
+typedef enum {
+    SENSOR_IDLE = 0,
+    SENSOR_POWER_ON,
+    SENSOR_SETTLE,
+    SENSOR_CONVERT,
+    SENSOR_READ,
+    SENSOR_POWER_OFF,
+} sensor_state_t;
+
+typedef struct {
+    sensor_state_t state;
+    uint8_t id;             // Registry id of the probe being sampled
+    TickType_t settle_end;
+    uint8_t read_retries;
+    uint32_t next_period_ms;    // Shortest period asked for by a probe this scan
+} sensor_acq_t;
+
+// Previous sample and report of each probe, indexed by registry id
+typedef struct {
+    float reading;
+    TickType_t sampled;
+    TickType_t reported;
+    bool valid;
+} probe_history_t;
+
+// RTOS items
+static TimerHandle_t sensor_timer;
+static TaskHandle_t sensor_task_handle;
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+static StackType_t sensor_task_stack[SENSOR_TASK_STACK];
+static StaticTask_t sensor_task_buffer;
+static StaticTimer_t sensor_timer_buffer;
+#endif
+
+#ifdef CONFIG_EXAMPLE_SENSOR_ACQ_CONTINUOUS
+static adc_continuous_handle_t adc_handle;
+static uint8_t burst_buf[SENSOR_BURST_BYTES];
+static uint16_t burst_samples[CONFIG_EXAMPLE_SENSOR_BURST_SAMPLES];
+#else
+static adc_oneshot_unit_handle_t adc_handle;
+#endif
+static adc_cali_handle_t adc_cali_handle;
+
+// Moisture table per probe, indexed by registry id
+static sensor_lut_t *probe_lut[DEVICE_MAX];
+
+static sensor_acq_t acq;
+static probe_history_t history[DEVICE_MAX];
+static uint32_t sample_period_ms = SAMPLE_PERIOD_MIN_S * 1000;
+
+static const char *TAG = "SENSOR";
+
+static esp_err_t sensor_init(device_desc_t *dev);
+
+const device_hw_ops_t sensor_hw_ops = {
+    .init = sensor_init,
+    .apply = NULL,  // Sensors take no commands
+};
+
+/******************************************************
+ * Acquisition
+******************************************************/
+
+#ifdef CONFIG_EXAMPLE_SENSOR_ACQ_CONTINUOUS
+#if defined(CONFIG_EXAMPLE_SENSOR_FILTER_MEDIAN)
+#define SENSOR_FILTER SENSOR_FILTER_MEDIAN
+#define SENSOR_TRIM_PERCENT 0
+#elif defined(CONFIG_EXAMPLE_SENSOR_FILTER_TRIMMED_MEAN)
+#define SENSOR_FILTER SENSOR_FILTER_TRIMMED_MEAN
+#define SENSOR_TRIM_PERCENT CONFIG_EXAMPLE_SENSOR_TRIM_PERCENT
+#else
+#define SENSOR_FILTER SENSOR_FILTER_MEAN
+#define SENSOR_TRIM_PERCENT 0
+#endif
+
+static esp_err_t adc_unit_init(void)
+{
+    adc_continuous_handle_cfg_t adc_config = {
+        .max_store_buf_size = SENSOR_BURST_BYTES,
+        .conv_frame_size = SENSOR_BURST_BYTES,
+    };
+
+    return adc_continuous_new_handle(&adc_config, &adc_handle);
+}
+
+static esp_err_t adc_channel_init(device_desc_t *sensor)
+{
+    // The burst pattern is set per probe when its conversion starts
+    return ESP_OK;
+}
+
+/**
+ * @brief Start a DMA burst on the probe's channel, the CPU is free until it completes.
+*/
+static esp_err_t adc_begin(device_desc_t *sensor)
+{
+    adc_digi_pattern_config_t pattern = {
+        .atten = ADC_ATTEN,
+        .channel = sensor->adc_channel,
+        .unit = ADC_UNIT,
+        .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+    adc_continuous_config_t config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = SENSOR_BURST_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+
+    esp_err_t err = adc_continuous_config(adc_handle, &config);
+    if (err == ESP_OK) {
+        err = adc_continuous_start(adc_handle);
+    }
+    return err;
+}
+
+/**
+ * @brief Collect the finished burst and reduce it to one raw value.
+ *
+ * @return ESP_ERR_TIMEOUT if the burst has not completed yet
+*/
+static esp_err_t adc_collect(device_desc_t *sensor, int *raw)
+{
+    uint32_t length = 0;
+    esp_err_t err = adc_continuous_read(adc_handle, burst_buf, sizeof(burst_buf), &length, 0);
+    if (err == ESP_ERR_TIMEOUT) {
+        return err;
+    }
+    adc_continuous_stop(adc_handle);
+
+    size_t count = 0;
+    for (uint32_t i = 0; err == ESP_OK && i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        adc_digi_output_data_t *result = (adc_digi_output_data_t *)&burst_buf[i];
+        if (result->type2.channel == sensor->adc_channel) {
+            burst_samples[count++] = result->type2.data;
+        }
+    }
+
+    // Drop whatever was converted between the read and the stop so the next burst starts clean
+    while (adc_continuous_read(adc_handle, burst_buf, sizeof(burst_buf), &length, 0) == ESP_OK) {
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    *raw = sensor_filter_apply(SENSOR_FILTER, burst_samples, count, SENSOR_TRIM_PERCENT);
+    return (*raw < 0) ? ESP_FAIL : ESP_OK;
+}
+
+/**
+ * @brief Give up on a burst that never completed, a running driver would refuse the next adc_begin().
+*/
+static void adc_abort(device_desc_t *sensor)
+{
+    uint32_t length = 0;
+
+    adc_continuous_stop(adc_handle);
+    while (adc_continuous_read(adc_handle, burst_buf, sizeof(burst_buf), &length, 0) == ESP_OK) {
+    }
+}
+#else
+static esp_err_t adc_unit_init(void)
+{
+    adc_oneshot_unit_init_cfg_t adc_config = {
+        .unit_id = ADC_UNIT,
+    };
+
+    return adc_oneshot_new_unit(&adc_config, &adc_handle);
+}
+
+static esp_err_t adc_channel_init(device_desc_t *sensor)
+{
+    // ADC for analog read
+    adc_oneshot_chan_cfg_t channel_config = {
+        .bitwidth = ADC_BITWIDTH,
+        .atten = ADC_ATTEN,
+    };
+
+    return adc_oneshot_config_channel(adc_handle, sensor->adc_channel, &channel_config);
+}
+
+static esp_err_t adc_begin(device_desc_t *sensor)
+{
+    return ESP_OK;
+}
+
+static esp_err_t adc_collect(device_desc_t *sensor, int *raw)
+{
+    return adc_oneshot_read(adc_handle, sensor->adc_channel, raw);
+}
+
+static void adc_abort(device_desc_t *sensor)
+{
+}
+#endif
+
+static esp_err_t sensor_read(device_desc_t *sensor, float *reading)
+{
+#ifdef CONFIG_EXAMPLE_SENSOR_SIMULATED
+    *reading = (float)(rand() % 20 + 60);
+    return ESP_OK;
+#else
+    int raw_value = -1;
+    esp_err_t err = adc_collect(sensor, &raw_value);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Raw count -> calibrated millivolts -> moisture through the probe's table
+    int mv;
+    if (!adc_cali_handle || adc_cali_raw_to_voltage(adc_cali_handle, raw_value, &mv) != ESP_OK) {
+        mv = (raw_value * ADC_FULL_SCALE_MV) >> ADC_RAW_BITS;
+    }
+    uint16_t centi_percent = sensor_lut_lookup(probe_lut[registry_id(sensor)], mv);
+    // ESP_LOGI(TAG, "Raw ADC value: %d, %d mV, moisture %u", raw_value, mv, centi_percent);
+    *reading = centi_percent * 0.01f;
+    return ESP_OK;
+#endif
+}
+
+static bool sensor_next(uint8_t from)
+{
+    for (uint8_t id = from; id < registry_count(); id++) {
+        if (registry_get(id)->type == DEVICE_SENSOR) {
+            acq.id = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void sensor_power(device_desc_t *sensor, bool on)
+{
+#ifdef CONFIG_EXAMPLE_SENSOR_SCAN
+    // The whole batch shares one power window
+    for (uint8_t id = 0; id < registry_count(); id++) {
+        device_desc_t *dev = registry_get(id);
+        if (dev->type == DEVICE_SENSOR) {
+            hal_gpio_write(dev->gpio, on);
+        }
+    }
+#else
+    hal_gpio_write(sensor->gpio, on);
+#endif
+}
+
+/**
+ * @brief Pick the step after a probe has been read (or failed to read).
+*/
+static sensor_state_t sensor_after_read(void)
+{
+#ifdef CONFIG_EXAMPLE_SENSOR_SCAN
+    // Still powered and settled, go straight to the next channel
+    return sensor_next(acq.id + 1) ? SENSOR_CONVERT : SENSOR_POWER_OFF;
+#else
+    return SENSOR_POWER_OFF;
+#endif
+}
+
+/******************************************************
+ * Adaptive sampling
+******************************************************/
+
+/**
+ * @brief Sample period a probe asks for after its latest reading.
+*/
+static uint32_t sensor_wanted_period(probe_history_t *probe, float reading, TickType_t now)
+{
+    const uint32_t min_ms = SAMPLE_PERIOD_MIN_S * 1000;
+    const uint32_t max_ms = SAMPLE_PERIOD_MAX_S * 1000;
+
+    if (!probe->valid) {
+        return min_ms;
+    }
+
+    controller_config_t control;
+    controller_get_config(&control);
+
+    float delta = fabsf(reading - probe->reading);
+    uint32_t elapsed_ms = pdTICKS_TO_MS(now - probe->sampled);
+    float rate = (elapsed_ms > 0) ? delta * 60000.0f / elapsed_ms : 0.0f;
+    float margin = fminf(fabsf(reading - control.dry), fabsf(reading - control.wet));
+
+    if (rate >= SAMPLE_FAST_RATE || margin <= SAMPLE_NEAR_BAND || controller_watering()) {
+        return min_ms;
+    }
+
+    uint32_t period = (delta <= SAMPLE_FLAT_DELTA) ? sample_period_ms * 2 : sample_period_ms / 2;
+    return (period < min_ms) ? min_ms : (period > max_ms) ? max_ms : period;
+}
+
+/**
+ * @brief Apply the period chosen by the scan that just finished.
+*/
+static void sensor_reschedule(void)
+{
+    if (acq.next_period_ms != sample_period_ms) {
+        sample_period_ms = acq.next_period_ms;
+        // Also restarts the timer, the next sample is one new period from now
+        xTimerChangePeriod(sensor_timer, pdMS_TO_TICKS(sample_period_ms), 0);
+        ESP_LOGI(TAG, "Sampling every %lu s", (unsigned long)(sample_period_ms / 1000));
+    }
+    power_scan_done(sample_period_ms);
+}
+
+/**
+ * @brief Advance the acquisition state machine by one step.
+ *
+ * @return ticks to wait before the next step, 0 to step again right away
+*/
+static TickType_t sensor_step(void)
+{
+    device_desc_t *sensor = registry_get(acq.id);
+
+    switch (acq.state) {
+        case SENSOR_IDLE:
+            return portMAX_DELAY;
+        case SENSOR_POWER_ON:
+            // Provide power to Sensor
+            sensor_power(sensor, true);
+            acq.settle_end = xTaskGetTickCount() + pdMS_TO_TICKS(SENSOR_SETTLE_MS);
+            acq.state = SENSOR_SETTLE;
+            return pdMS_TO_TICKS(SENSOR_SETTLE_MS);
+        case SENSOR_SETTLE: {
+            // Woken early by a new request, keep waiting out the window
+            TickType_t remaining = acq.settle_end - xTaskGetTickCount();
+            if ((int32_t)remaining > 0) {
+                return remaining;
+            }
+            acq.state = SENSOR_CONVERT;
+            return 0;
+        }
+        case SENSOR_CONVERT:
+            acq.read_retries = 0;
+            if (adc_begin(sensor) != ESP_OK) {
+                ESP_LOGE(TAG, "Could not start conversion on %s", sensor->name);
+                acq.state = sensor_after_read();
+                return 0;
+            }
+            acq.state = SENSOR_READ;
+            return SENSOR_CONVERT_TICKS;
+        case SENSOR_READ: {
+            float reading;
+            esp_err_t err = sensor_read(sensor, &reading);
+
+            if (err == ESP_ERR_TIMEOUT && ++acq.read_retries < SENSOR_READ_RETRIES) {
+                // Burst still running, check back on the next tick
+                return 1;
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Could not read %s: %s", sensor->name, esp_err_to_name(err));
+                if (err == ESP_ERR_TIMEOUT) {
+                    adc_abort(sensor);
+                }
+                acq.state = sensor_after_read();
+                return 0;
+            }
+            sensor->reading = reading;
+            boot_mark(BOOT_FIRST_SAMPLE);
+            persist_mark_dirty(PERSIST_SAMPLE);
+
+            TickType_t now = xTaskGetTickCount();
+            probe_history_t *probe = &history[acq.id];
+            uint32_t wanted = sensor_wanted_period(probe, reading, now);
+            if (wanted < acq.next_period_ms) {
+                acq.next_period_ms = wanted;
+            }
+
+            // Reports are rate limited separately from sampling
+            if (!probe->valid || now - probe->reported >= pdMS_TO_TICKS(REPORTING_PERIOD * 1000)) {
+                event_packet_t sensor_data_to_app = {
+                    .direction = ESP_TO_APP,
+                    .device = acq.id,
+                    .payload = PAYLOAD_READING,
+                    .data.reading = sensor->reading,
+                };
+                event_send(&sensor_data_to_app, PRODUCER_SENSOR);
+                probe->reported = now;
+            }
+            probe->reading = reading;
+            probe->sampled = now;
+            probe->valid = true;
+
+            // Act on the new sample locally, no cloud round trip
+            controller_update(sensor);
+
+            acq.state = sensor_after_read();
+            return 0;
+        }
+        case SENSOR_POWER_OFF:
+            // Turn off power to sensor
+            sensor_power(sensor, false);
+#ifdef CONFIG_EXAMPLE_SENSOR_SCAN
+            acq.state = SENSOR_IDLE;
+#else
+            acq.state = sensor_next(acq.id + 1) ? SENSOR_POWER_ON : SENSOR_IDLE;
+#endif
+            if (acq.state == SENSOR_IDLE) {
+                sensor_reschedule();
+            }
+            return 0;
+    }
+    return portMAX_DELAY;
+}
+
+static void sensor_task(void *arg)
+{
+    TickType_t wait = portMAX_DELAY;
+
+    while (true) {
+        bool requested = ulTaskNotifyTake(pdTRUE, wait) > 0;
+
+        if (requested && acq.state == SENSOR_IDLE && sensor_next(0)) {
+            acq.state = SENSOR_POWER_ON;
+            acq.next_period_ms = SAMPLE_PERIOD_MAX_S * 1000;
+        }
+
+        while ((wait = sensor_step()) == 0) {
+        }
+    }
+}
+
+void sensor_request_sample(void)
+{
+    if (sensor_task_handle) {
+        xTaskNotifyGive(sensor_task_handle);
+    }
+}
+
+static void sensor_update(TimerHandle_t handle)
+{
+    // Runs on the timer service task, hand the work over and return
+    sensor_request_sample();
+}
+
+/******************************************************
+ * Calibration
+******************************************************/
+
+/**
+ * @brief Build the moisture table of a probe from its factory breakpoints,
+ * stored as blob "probe<n>" in the fctry partition, or from the default curve.
+*/
+static esp_err_t sensor_cal_load(device_desc_t *dev, uint8_t instance)
+{
+    sensor_cal_points_t points = sensor_cal_default;
+    sensor_cal_points_t stored;
+    size_t length = sizeof(stored);
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t handle;
+
+    snprintf(key, sizeof(key), "probe%u", instance);
+    if (nvs_flash_init_partition(SENSOR_CAL_PARTITION) == ESP_OK &&
+        nvs_open_from_partition(SENSOR_CAL_PARTITION, SENSOR_CAL_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_blob(handle, key, &stored, &length) == ESP_OK && length == sizeof(stored)
+            && sensor_cal_valid(&stored)) {
+            points = stored;
+            ESP_LOGI(TAG, "%s: using factory calibration (%u points)", dev->name, stored.count);
+        }
+        nvs_close(handle);
+    }
+
+    sensor_lut_t *lut = malloc(sizeof(sensor_lut_t));
+    if (!lut) {
+        return ESP_ERR_NO_MEM;
+    }
+    sensor_lut_build(lut, &points);
+    probe_lut[registry_id(dev)] = lut;
+    return ESP_OK;
+}
+
+/******************************************************
+ * Initialisation
+******************************************************/
+
+static esp_err_t sensor_init(device_desc_t *dev)
+{
+    // Digital output to control sensor power
+    hal_gpio_output(dev->gpio, false);
+    hal_gpio_write(dev->gpio, 0);
+
+    if (sensor_cal_load(dev, registry_instance(dev)) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not load calibration for %s", dev->name);
+        return ESP_FAIL;
+    }
+
+    // ADC unit, calibration, task and timer are shared by all sensors
+    if (!adc_handle) {
+        if (adc_unit_init() != ESP_OK) {
+            ESP_LOGE(TAG, "Could not initialise ADC unit");
+            return ESP_FAIL;
+        }
+
+        adc_cali_curve_fitting_config_t cali_config = {
+            .unit_id = ADC_UNIT,
+            .atten = ADC_ATTEN,
+            .bitwidth = ADC_BITWIDTH,
+        };
+
+        if (adc_cali_create_scheme_curve_fitting(&cali_config, &adc_cali_handle) != ESP_OK) {
+            ESP_LOGW(TAG, "ADC calibration not available, using nominal scale");
+            adc_cali_handle = NULL;
+        }
+    }
+
+    if (adc_channel_init(dev) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not configure ADC channel %d for %s", dev->adc_channel, dev->name);
+        return ESP_FAIL;
+    }
+
+    if (power_resumed()) {
+        // Pick up from the reading taken before deep sleep, one period ago
+        sample_period_ms = power_sample_period_ms(sample_period_ms);
+        TickType_t before = xTaskGetTickCount() - pdMS_TO_TICKS(sample_period_ms);
+        history[registry_id(dev)] = (probe_history_t) {
+            .reading = dev->reading,
+            .sampled = before,
+            .reported = before,
+            .valid = true,
+        };
+    }
+
+    if (sensor_timer) {
+        return ESP_OK;
+    }
+
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    // Stack depth is in bytes on ESP-IDF, StackType_t is a byte
+    sensor_task_handle = xTaskCreateStaticPinnedToCore(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL,
+                    SENSOR_TASK_PRIORITY, sensor_task_stack, &sensor_task_buffer, APP_TASK_CORE);
+#else
+    xTaskCreatePinnedToCore(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL,
+                    SENSOR_TASK_PRIORITY, &sensor_task_handle, APP_TASK_CORE);
+#endif
+    if (!sensor_task_handle) {
+        ESP_LOGE(TAG, "Could not create sensor task");
+        return ESP_FAIL;
+    }
+
+    // Start timer to trigger every sample period, adapted after each scan
+#ifdef CONFIG_EXAMPLE_STATIC_ALLOC
+    sensor_timer = xTimerCreateStatic("sensor_update_tm", pdMS_TO_TICKS(sample_period_ms),
+                            pdTRUE, NULL, sensor_update, &sensor_timer_buffer);
+#else
+    sensor_timer = xTimerCreate("sensor_update_tm", pdMS_TO_TICKS(sample_period_ms),
+                            pdTRUE, NULL, sensor_update);
+#endif
+    if (sensor_timer) {
+        xTimerStart(sensor_timer, 0);
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "device.h"
+
+#define ADC_UNIT  ADC_UNIT_1
+#define ADC_ATTEN ADC_ATTEN_DB_11
+#define ADC_BITWIDTH ADC_BITWIDTH_DEFAULT
+
+// Acquisition task, owns probe power and the ADC
+#define SENSOR_TASK_STACK       3072
+#define SENSOR_TASK_PRIORITY    5
+
+// How often the READ step polls for a conversion before giving up
+#define SENSOR_READ_RETRIES     5
+
+#ifdef CONFIG_EXAMPLE_SENSOR_ACQ_CONTINUOUS
+// DMA burst taken once the probe has settled
+#define SENSOR_BURST_FREQ_HZ    20000
+#define SENSOR_BURST_BYTES      (CONFIG_EXAMPLE_SENSOR_BURST_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES)
+// Ticks to let the burst run before collecting it, at least one
+#define SENSOR_CONVERT_TICKS    (pdMS_TO_TICKS(CONFIG_EXAMPLE_SENSOR_BURST_SAMPLES * 1000 / SENSOR_BURST_FREQ_HZ) + 1)
+#else
+#define SENSOR_CONVERT_TICKS    0
+#endif
+
+// Adaptive sampling: fall back to the minimum period when a reading moves
+// faster than SAMPLE_FAST_RATE (% per minute), comes within SAMPLE_NEAR_BAND (%)
+// of a control threshold or a pump is running, double it while readings stay
+// within SAMPLE_FLAT_DELTA (%), halve it otherwise
+#define SAMPLE_FAST_RATE        1.0f
+#define SAMPLE_NEAR_BAND        3.0f
+#define SAMPLE_FLAT_DELTA       0.5f
+
+// Factory calibration breakpoints, one blob per probe instance
+#define SENSOR_CAL_PARTITION    "fctry"
+#define SENSOR_CAL_NAMESPACE    "sensor_cal"
+
+// Nominal scale used when the chip has no ADC calibration eFuses
+#define ADC_FULL_SCALE_MV       3100
+#define ADC_RAW_BITS            12
+
+// Hardware ops referenced by the device registry
+extern const device_hw_ops_t sensor_hw_ops;
+
+/**
+ * @brief Ask the acquisition task to sample every registered probe.
+ *
+ * Never blocks, safe to call from timer callbacks. A request that arrives
+ * while a scan is running is folded into that scan.
+*/
+void sensor_request_sample(void);
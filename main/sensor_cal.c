@@ -0,0 +1,65 @@
+#include "sensor_cal.h"
+
+#define LUT_STEP_MASK ((1 << SENSOR_LUT_SHIFT) - 1)
+
+// 0..3100 mV is the usable span of ADC1 at 11 dB, full scale reads as 100 %
+const sensor_cal_points_t sensor_cal_default = {
+    .count = 2,
+    .mv = { 0, 3100 },
+    .centi_percent = { 0, 10000 },
+};
+
+bool sensor_cal_valid(const sensor_cal_points_t *points)
+{
+    if (points->count < 2 || points->count > SENSOR_CAL_MAX_POINTS) {
+        return false;
+    }
+    for (int i = 1; i < points->count; i++) {
+        if (points->mv[i] <= points->mv[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint16_t interpolate_points(const sensor_cal_points_t *points, int mv)
+{
+    int last = points->count - 1;
+
+    if (mv <= points->mv[0]) {
+        return points->centi_percent[0];
+    }
+    if (mv >= points->mv[last]) {
+        return points->centi_percent[last];
+    }
+
+    int i = 1;
+    while (mv > points->mv[i]) {
+        i++;
+    }
+    int32_t x0 = points->mv[i - 1], x1 = points->mv[i];
+    int32_t y0 = points->centi_percent[i - 1], y1 = points->centi_percent[i];
+    return (uint16_t)(y0 + (y1 - y0) * (mv - x0) / (x1 - x0));
+}
+
+void sensor_lut_build(sensor_lut_t *lut, const sensor_cal_points_t *points)
+{
+    for (int i = 0; i < SENSOR_LUT_SIZE; i++) {
+        lut->centi_percent[i] = interpolate_points(points, i << SENSOR_LUT_SHIFT);
+    }
+}
+
+uint16_t sensor_lut_lookup(const sensor_lut_t *lut, int mv)
+{
+    if (mv <= 0) {
+        return lut->centi_percent[0];
+    }
+    if (mv >= SENSOR_LUT_MAX_MV) {
+        mv = SENSOR_LUT_MAX_MV;
+    }
+
+    int i = mv >> SENSOR_LUT_SHIFT;
+    int32_t a = lut->centi_percent[i];
+    int32_t b = lut->centi_percent[i + 1];
+    return (uint16_t)(a + (((b - a) * (mv & LUT_STEP_MASK)) >> SENSOR_LUT_SHIFT));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Calibration breakpoints for one probe, as stored in the fctry partition
+#define SENSOR_CAL_MAX_POINTS   8
+
+// Dense lookup table, one entry every 2^SENSOR_LUT_SHIFT millivolts
+#define SENSOR_LUT_SHIFT        5
+#define SENSOR_LUT_MAX_MV       3300
+#define SENSOR_LUT_SIZE         ((SENSOR_LUT_MAX_MV >> SENSOR_LUT_SHIFT) + 2)
+
+typedef struct {
+    uint8_t count;
+    uint16_t mv[SENSOR_CAL_MAX_POINTS];             // Ascending probe voltages
+    uint16_t centi_percent[SENSOR_CAL_MAX_POINTS];  // Moisture reading at each voltage, 0.01 % units
+} sensor_cal_points_t;
+
+typedef struct {
+    uint16_t centi_percent[SENSOR_LUT_SIZE];
+} sensor_lut_t;
+
+// Used for probes without factory calibration, matches the old linear raw mapping
+extern const sensor_cal_points_t sensor_cal_default;
+
+/**
+ * @brief Check that a set of breakpoints can be expanded into a table.
+*/
+bool sensor_cal_valid(const sensor_cal_points_t *points);
+
+/**
+ * @brief Expand breakpoints into the dense table, all divisions happen here.
+*/
+void sensor_lut_build(sensor_lut_t *lut, const sensor_cal_points_t *points);
+
+/**
+ * @brief Millivolts to moisture in 0.01 % units, a table lookup with linear interpolation.
+*/
+uint16_t sensor_lut_lookup(const sensor_lut_t *lut, int mv);
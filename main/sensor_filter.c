@@ -0,0 +1,49 @@
+#include "sensor_filter.h"
+
+// Bursts are a few hundred samples at most, insertion sort is cheap and needs no buffer
+static void sort_samples(uint16_t *samples, size_t count)
+{
+    for (size_t i = 1; i < count; i++) {
+        uint16_t value = samples[i];
+        size_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+}
+
+static int mean(const uint16_t *samples, size_t count)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    return (int)((sum + count / 2) / count);
+}
+
+int sensor_filter_apply(sensor_filter_t filter, uint16_t *samples, size_t count, uint8_t trim_percent)
+{
+    if (count == 0) {
+        return -1;
+    }
+
+    switch (filter) {
+        case SENSOR_FILTER_MEDIAN:
+            sort_samples(samples, count);
+            return (count % 2) ? samples[count / 2]
+                               : (samples[count / 2 - 1] + samples[count / 2] + 1) / 2;
+        case SENSOR_FILTER_TRIMMED_MEAN: {
+            size_t trim = count * trim_percent / 100;
+            if (2 * trim >= count) {
+                trim = (count - 1) / 2;
+            }
+            sort_samples(samples, count);
+            return mean(samples + trim, count - 2 * trim);
+        }
+        case SENSOR_FILTER_MEAN:
+        default:
+            return mean(samples, count);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Reduction applied to a burst of raw ADC samples
+typedef enum {
+    SENSOR_FILTER_MEAN = 0,
+    SENSOR_FILTER_MEDIAN,
+    SENSOR_FILTER_TRIMMED_MEAN,
+} sensor_filter_t;
+
+/**
+ * @brief Reduce a burst of samples to a single value.
+ *
+ * Median and trimmed mean sort `samples` in place.
+ *
+ * @param trim_percent share of samples dropped from each end for the trimmed mean
+ * @return the filtered value, or -1 if `count` is 0
+*/
+int sensor_filter_apply(sensor_filter_t filter, uint16_t *samples, size_t count, uint8_t trim_percent);
@@ -0,0 +1,137 @@
+#include "status_led.h"
+#include "hal.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+typedef struct {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+} led_rgb_t;
+
+// Full scale colours, dimmed by the brightness setting
+static const led_rgb_t status_colours[LED_STATUS_MAX] = {
+    [LED_STATUS_OK] = { 0, 255, 0 },
+    [LED_STATUS_WET] = { 0, 64, 255 },
+    [LED_STATUS_DRY] = { 255, 96, 0 },
+};
+static const led_rgb_t offline_colour = { 160, 0, 255 };
+
+// round(255 * (percent / 100) ^ 2.2), so equal brightness steps look equal
+static const uint8_t gamma_table[LED_BRIGHTNESS_MAX + 1] = {
+      0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   2,   2,
+      2,   3,   3,   4,   5,   5,   6,   7,   7,   8,   9,  10,
+     11,  12,  13,  14,  15,  17,  18,  19,  21,  22,  24,  25,
+     27,  29,  30,  32,  34,  36,  38,  40,  42,  44,  46,  48,
+     51,  53,  55,  58,  60,  63,  66,  68,  71,  74,  77,  80,
+     83,  86,  89,  92,  96,  99, 102, 106, 109, 113, 116, 120,
+    124, 128, 131, 135, 139, 143, 148, 152, 156, 160, 165, 169,
+    174, 178, 183, 188, 192, 197, 202, 207, 212, 217, 223, 228,
+    233, 238, 244, 249, 255,
+};
+
+static struct {
+    bool on;
+    bool offline;
+    uint8_t brightness;
+    led_status_t status;
+    led_rgb_t shown;        // Last colour sent to the LED
+    bool shown_valid;
+} led = {
+    .brightness = LED_BRIGHTNESS_MAX,
+};
+
+// Callers include the event task, the sensor task and the input task (boot button taps)
+static SemaphoreHandle_t led_mutex;
+static StaticSemaphore_t led_mutex_buffer;
+
+static uint8_t scale(uint8_t channel, uint8_t level)
+{
+    return (uint8_t)((channel * level + 254) / 255);
+}
+
+/**
+ * @brief Work out the colour for the current state and only talk to the LED when it changed.
+*/
+static void status_led_refresh(void)
+{
+    led_rgb_t target = { 0, 0, 0 };
+
+    if (led.on) {
+        const led_rgb_t *base = led.offline ? &offline_colour : &status_colours[led.status];
+        uint8_t level = gamma_table[led.brightness];
+
+        // Keep low settings visible instead of rounding them to dark
+        if (level == 0 && led.brightness > 0) {
+            level = 1;
+        }
+        target = (led_rgb_t) {
+            scale(base->red, level), scale(base->green, level), scale(base->blue, level),
+        };
+    }
+
+    if (led.shown_valid && target.red == led.shown.red && target.green == led.shown.green &&
+        target.blue == led.shown.blue) {
+        return;
+    }
+
+    hal_led_write(target.red, target.green, target.blue);
+    led.shown = target;
+    led.shown_valid = true;
+}
+
+void status_led_init(void)
+{
+    led_mutex = xSemaphoreCreateMutexStatic(&led_mutex_buffer);
+    hal_led_init();
+
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    led.shown_valid = false;
+    status_led_refresh();
+    xSemaphoreGive(led_mutex);
+}
+
+void status_led_set_power(bool on)
+{
+    if (!led_mutex) {
+        return;
+    }
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    led.on = on;
+    status_led_refresh();
+    xSemaphoreGive(led_mutex);
+}
+
+void status_led_set_brightness(uint8_t percent)
+{
+    if (!led_mutex) {
+        return;
+    }
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    led.brightness = (percent > LED_BRIGHTNESS_MAX) ? LED_BRIGHTNESS_MAX : percent;
+    status_led_refresh();
+    xSemaphoreGive(led_mutex);
+}
+
+void status_led_set_status(led_status_t status)
+{
+    if (!led_mutex || status >= LED_STATUS_MAX) {
+        return;
+    }
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    led.status = status;
+    status_led_refresh();
+    xSemaphoreGive(led_mutex);
+}
+
+void status_led_set_offline(bool offline)
+{
+    if (!led_mutex) {
+        return;
+    }
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    led.offline = offline;
+    status_led_refresh();
+    xSemaphoreGive(led_mutex);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Controller state shown by the LED colour while it is on
+typedef enum {
+    LED_STATUS_OK = 0,      // Beds between the wet and dry thresholds
+    LED_STATUS_WET,         // Every bed at or below the wet threshold
+    LED_STATUS_DRY,         // Some bed past the dry threshold
+    LED_STATUS_MAX,
+} led_status_t;
+
+// Brightness is a percentage, as in the RainMaker brightness param
+#define LED_BRIGHTNESS_MAX 100
+
+/**
+ * @brief Set up the ws2812 driver, the LED starts dark.
+*/
+void status_led_init(void);
+
+void status_led_set_power(bool on);
+
+/**
+ * @brief Perceived brightness in percent, mapped to PWM levels through a gamma table.
+*/
+void status_led_set_brightness(uint8_t percent);
+
+/**
+ * @brief Controller state shown by the LED colour.
+*/
+void status_led_set_status(led_status_t status);
+
+/**
+ * @brief Show the offline colour until the cloud connection is back, overrides the status.
+*/
+void status_led_set_offline(bool offline);